@@ -0,0 +1,298 @@
+/*
+ * Simulated MCP3201 for the backends of adc3201.cpp.
+ *
+ * The converter is modelled as a shift register clocked by CS and CLK edges
+ * on a virtual time line: it loads the next code of a test sequence when CS
+ * falls and shifts out the null bit and B11..B0, then B1..B11, on falling
+ * clock edges. It checks the datasheet timing of every edge (CS setup,
+ * clock high and low times, output valid delay, CS high time) and counts
+ * the violations.
+ *
+ * The protocol code of mcp3201.h runs against it through host versions of
+ * the GPIO and HSPI ports, once per 125 us sample tick, where each register
+ * access takes ADC_REG_CYCLES CPU cycles and wait() moves time on. Both
+ * backends must return the codes converted (the HSPI one a sample late)
+ * without a timing violation; a port that doesn't wait must be caught.
+ * Reports the register accesses, the busy waits and the estimated cycles of
+ * a sample at 80 MHz, and the host time of the simulation.
+ *
+ *   adcsim [-n samples]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "mcp3201.h"
+
+#define CPU_MHZ         80
+#define ADC_REG_CYCLES  4       /* assumed cost of a peripheral register access */
+#define REG_NS          (ADC_REG_CYCLES * 1000.0 / CPU_MHZ)
+#define TICK_NS         125000.0
+
+class Mcp3201Model
+{
+public:
+    Mcp3201Model(const short *codes, int n) : codes(codes), n(n)
+    {
+        csLevel = 1;
+        clkLevel = 0;
+        next = 0;
+        falls = 0;
+        bit = 1;
+        code = 0;
+        tCsFall = tCsRise = tRise = tFall = tValid = -1e30;
+        conversions = violations = 0;
+        lastViolation = NULL;
+    }
+
+    void cs(int level, double t)
+    {
+        if (level == csLevel)
+            return;
+        csLevel = level;
+        if (level)
+        {
+            tCsRise = t;
+            return;
+        }
+        check(t - tCsRise >= MCP3201_T_CSH, "CS high time");
+        tCsFall = t;
+        falls = 0;
+        bit = 1;                    /* Hi-Z until the null bit */
+        code = codes[next++ % n];   /* sampled over the first clocks */
+        conversions++;
+    }
+
+    void clk(int level, double t)
+    {
+        if (level == clkLevel)
+            return;
+        clkLevel = level;
+        if (csLevel)
+            return;
+        if (level)
+        {
+            if (falls == 0)
+                check(t - tCsFall >= MCP3201_T_SUCS, "CS setup");
+            else
+                check(t - tFall >= MCP3201_T_LO, "clock low time");
+            tRise = t;
+            return;
+        }
+        check(t - tRise >= MCP3201_T_HI, "clock high time");
+        tFall = t;
+        tValid = t + MCP3201_T_DO;
+        falls++;
+        if (falls == 2)
+            bit = 0;                                        /* null bit */
+        else if (falls >= 3 && falls < 3 + MCP3201_BITS)
+            bit = (code >> (MCP3201_BITS + 2 - falls)) & 1; /* B11..B0 */
+        else if (falls >= 3 + MCP3201_BITS && falls < 2 + 2 * MCP3201_BITS)
+            bit = (code >> (falls - 2 - MCP3201_BITS)) & 1; /* B1..B11 */
+        else
+            bit = 0;
+    }
+
+    int dout(double t)
+    {
+        if (csLevel)
+            return 1;
+        if (falls >= 2)
+            check(t >= tValid, "output valid delay");
+        return bit;
+    }
+
+    int conversions, violations;
+    const char *lastViolation;
+
+private:
+    void check(bool ok, const char *what)
+    {
+        if (!ok)
+        {
+            violations++;
+            lastViolation = what;
+        }
+    }
+
+    const short *codes;
+    int n, next;
+    int csLevel, clkLevel, falls, bit;
+    unsigned code;
+    double tCsFall, tCsRise, tRise, tFall, tValid;
+};
+
+/* the GpioPort of adc3201.cpp on the model: every access takes REG_NS */
+struct SimGpioPort
+{
+    Mcp3201Model *adc;
+    double t, edge, waited;
+    long accesses;
+    bool waits;
+
+    void cs(int level)
+    {
+        t += REG_NS;
+        accesses++;
+        adc->cs(level, t);
+        edge = t;
+    }
+
+    void clk(int level)
+    {
+        t += REG_NS;
+        accesses++;
+        adc->clk(level, t);
+        edge = t;
+    }
+
+    int dout()
+    {
+        t += REG_NS;
+        accesses++;
+        return adc->dout(t);
+    }
+
+    void wait(int ns)
+    {
+        if (waits && t < edge + ns)
+        {
+            waited += edge + ns - t;
+            t = edge + ns;
+        }
+    }
+};
+
+/* the HspiPort: start() clocks a mode 0 transfer through the model at
+   MCP3201_SPI_HZ, busy() until its last edge */
+struct SimHspiPort : SimGpioPort
+{
+    double done;
+    unsigned rx;
+
+    int busy()
+    {
+        t += REG_NS;
+        accesses++;
+        return t < done;
+    }
+
+    unsigned word()
+    {
+        t += REG_NS;
+        accesses++;
+        return rx;
+    }
+
+    void start()
+    {
+        double half = 1e9 / MCP3201_SPI_HZ / 2;
+        int i;
+
+        t += REG_NS;
+        accesses++;
+        rx = 0;
+        for (i = 0; i < MCP3201_SPI_BITS; i++)
+        {
+            adc->clk(1, t + half * (2 * i + 1));
+            rx = (rx << 1) | adc->dout(t + half * (2 * i + 1));
+            adc->clk(0, t + half * (2 * i + 2));
+        }
+        done = t + half * 2 * MCP3201_SPI_BITS;
+    }
+};
+
+/* converts codes[] at one sample per tick with each backend; returns 1 if
+   the results or the timing are wrong */
+static int run(const char *name, int spi, bool waits, const short *codes, int n, bool expect_violations)
+{
+    Mcp3201Model adc(codes, n);
+    SimHspiPort port;
+    double busy = 0, worst = 0;
+    unsigned long long t0;
+    int errors = 0, i, failed = 0;
+
+    memset(&port, 0, sizeof(port));
+    port.adc = &adc;
+    port.waits = waits;
+    port.t = -TICK_NS;
+
+    t0 = now_ns();
+    for (i = 0; i < n + spi; i++)
+    {
+        double start;
+        short v, want;
+
+        port.t = i * TICK_NS;
+        start = port.t;
+        v = spi ? mcp3201_spi(port) : mcp3201_bitbang(port);
+        busy += port.t - start;
+        if (port.t - start > worst)
+            worst = port.t - start;
+
+        want = spi ? (i > 0 ? codes[i - 1] : 0) : codes[i];
+        if (v != want)
+            errors++;
+    }
+    t0 = now_ns() - t0;
+
+    printf("%-8s %6d samples: %5d wrong %5d timing violations  %4.1f accesses %6.2f us waiting %5.0f cycles/sample"
+        " (%4.1f%% of a tick, worst %5.0f)  sim %4.0f ns/sample\n",
+        name, n, errors, adc.violations, (double)port.accesses / (n + spi), port.waited / 1000 / (n + spi),
+        busy / (n + spi) * CPU_MHZ / 1000, busy / (n + spi) / TICK_NS * 100, worst * CPU_MHZ / 1000,
+        (double)t0 / (n + spi));
+
+    if (expect_violations)
+    {
+        if (adc.violations == 0)
+        {
+            printf("%s: timing violations not caught\n", name);
+            failed = 1;
+        }
+    }
+    else if (errors || adc.violations)
+    {
+        if (adc.violations)
+            printf("%s: %s violated\n", name, adc.lastViolation);
+        failed = 1;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const short edges[] = { 0, 4095, 0xaaa, 0x555, 1, 2048, 2047, 4094 };
+    int n = 8000, failed = 0, i;
+    unsigned seed = 1;
+    short *codes;
+
+    if (argc == 3 && strcmp(argv[1], "-n") == 0)
+        n = atoi(argv[2]);
+    else if (argc != 1)
+        n = 0;
+    if (n < (int)(sizeof(edges) / sizeof(edges[0])))
+    {
+        fprintf(stderr, "usage: %s [-n samples]\n", argv[0]);
+        return 1;
+    }
+
+    /* the codes with all bits alternating first, then random ones */
+    codes = (short *)malloc(n * sizeof(short));
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        codes[i] = i < (int)(sizeof(edges) / sizeof(edges[0])) ? edges[i] : (seed >> 16) & 0xfff;
+    }
+
+    printf("MCP3201 at %d kHz clock, %d cycles per register access at %d MHz, a sample every %.0f us\n",
+        MCP3201_SPI_HZ / 1000, ADC_REG_CYCLES, CPU_MHZ, TICK_NS / 1000);
+    failed |= run("gpio", 0, true, codes, n, false);
+    failed |= run("hspi", 1, true, codes, n, false);
+    failed |= run("nowait", 0, false, codes, n, true);
+
+    free(codes);
+    return failed;
+}
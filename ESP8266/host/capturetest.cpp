@@ -0,0 +1,213 @@
+/*
+ * Capture clock and decimator test.
+ *
+ * The sample timer of AudioIn.cpp is simulated on a time line of 80 MHz
+ * ticks: it counts down from its load value, fires at zero and reloads the
+ * last value loaded, and the interrupt, which calls SampleClock::tick(),
+ * runs a random latency after it fires. For each rate, over a long run,
+ * every sample k must be taken within 2 ticks of k * 80 MHz / rate, so the
+ * long-run rate must be exact, whatever the latency. Reports the worst
+ * error and how far off the one integer period of the old timer setup was,
+ * in ppm.
+ *
+ * The 2:1 decimator of the 16 kHz path (src/Decimator.h) must pass 1 and
+ * 3 kHz tones within 0.1 dB and take 5 kHz and up 55 dB down, and give the
+ * same samples in blocks of any even size as in one call.
+ *
+ *   capturetest [-s seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "AudioIn.h"
+#include "SampleClock.h"
+#include "Decimator.h"
+
+#define TIMER_HZ     80000000
+#define MAX_LATENCY  400        /* ticks from the timer firing to tick(), 5 us */
+#define MAX_ERROR    2          /* ticks a sample may be off its ideal time */
+
+/* the timer on a virtual time line of ticks */
+struct SimTimer
+{
+    long long now;      /* the time of the interrupt */
+    long long start;    /* when the count started */
+    uint32_t counting;  /* what it is counting down from */
+    uint32_t reload;    /* what it counts from after firing */
+
+    uint32_t count() { return counting - (uint32_t)(now - start); }
+
+    void load(uint32_t ticks)
+    {
+        start = now;
+        counting = reload = ticks;
+    }
+
+    long long fire() { return start + counting; }
+};
+
+/* samples seconds of rate through SampleClock; returns 1 if a sample is
+   more than MAX_ERROR ticks off */
+static int run_clock(uint32_t rate, int seconds, unsigned *seed)
+{
+    SampleClock clock;
+    SimTimer timer;
+    long long n = (long long)rate * seconds, k, t = 0;
+    double worst = 0, oldPpm;
+    uint32_t maxLatency = MAX_LATENCY, oldPeriod, before;
+    int loads = 0;
+
+    clock.begin(TIMER_HZ, rate);
+    if (maxLatency > clock.first() / 2)
+        maxLatency = clock.first() / 2;
+    memset(&timer, 0, sizeof(timer));
+    timer.load(clock.first());
+
+    for (k = 1; k <= n; k++)
+    {
+        double err;
+
+        /* fires and reloads */
+        t = timer.fire();
+        timer.start = t;
+        timer.counting = timer.reload;
+
+        err = t - (double)k * TIMER_HZ / rate;
+        if (fabs(err) > fabs(worst))
+            worst = err;
+
+        /* the interrupt, some time later */
+        *seed = *seed * 1103515245 + 12345;
+        timer.now = t + (*seed >> 16) % (maxLatency + 1);
+        before = timer.reload;
+        clock.tick(timer);
+        if (timer.reload != before)
+            loads++;
+    }
+
+    oldPeriod = TIMER_HZ / rate;
+    oldPpm = ((double)TIMER_HZ / oldPeriod - rate) / rate * 1e6;
+    printf("%6u Hz  %lld samples: worst %5.2f ticks off, %5.1f%% reloaded, rate %+.4f ppm (integer period %+7.2f ppm)\n",
+        rate, n, worst, 100.0 * loads / n,
+        ((double)n * TIMER_HZ / t - rate) / rate * 1e6, oldPpm);
+
+    if (fabs(worst) > MAX_ERROR)
+    {
+        printf("%u Hz: drifts\n", rate);
+        return 1;
+    }
+    return 0;
+}
+
+#define DECIM_LEN   16000
+#define DECIM_SKIP  64          /* outputs before the filter has settled */
+
+/* gain in dB of the decimator for a tone of f Hz at 16 kHz */
+static double tone_gain(double f, short *in, short *out)
+{
+    static Decimator2<DECIM_LEN> d;
+    double amp = 16000, sum = 0;
+    int i, n;
+
+    for (i = 0; i < DECIM_LEN; i++)
+        in[i] = (short)lrint(amp * sin(2 * M_PI * f * i / AUDIO_IN_WIDEBAND));
+    d.reset();
+    n = d.process(in, DECIM_LEN, out);
+    for (i = DECIM_SKIP; i < n; i++)
+        sum += (double)out[i] * out[i];
+    return 10 * log10(sum / (n - DECIM_SKIP) / (amp * amp / 2));
+}
+
+/* returns 1 if the decimator is off */
+static int run_decimator()
+{
+    static const double pass[] = { 1000, 3000 };
+    static const double stop[] = { 5000, 6000, 7500 };
+    static const int blocks[] = { 2, 34, 80, AUDIO_IN_FRAMESIZE };
+    short *in = (short *)malloc(DECIM_LEN * sizeof(short));
+    short *out = (short *)malloc(DECIM_LEN / 2 * sizeof(short));
+    short *ref = (short *)malloc(DECIM_LEN / 2 * sizeof(short));
+    unsigned seed = 1;
+    int failed = 0, i, b;
+
+    for (i = 0; i < (int)(sizeof(pass) / sizeof(pass[0])); i++)
+    {
+        double g = tone_gain(pass[i], in, out);
+
+        printf("decimator %5.0f Hz: %+7.2f dB\n", pass[i], g);
+        if (fabs(g) > 0.1)
+        {
+            printf("decimator: passband off\n");
+            failed = 1;
+        }
+    }
+    for (i = 0; i < (int)(sizeof(stop) / sizeof(stop[0])); i++)
+    {
+        double g = tone_gain(stop[i], in, out);
+
+        printf("decimator %5.0f Hz: %+7.2f dB\n", stop[i], g);
+        if (g > -55)
+        {
+            printf("decimator: aliases\n");
+            failed = 1;
+        }
+    }
+
+    /* full scale noise, one call, then in blocks */
+    {
+        static Decimator2<DECIM_LEN> d;
+
+        for (i = 0; i < DECIM_LEN; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            in[i] = (short)(seed >> 16);
+        }
+        d.process(in, DECIM_LEN, ref);
+    }
+    for (b = 0; b < (int)(sizeof(blocks) / sizeof(blocks[0])); b++)
+    {
+        Decimator2<AUDIO_IN_FRAMESIZE> d;
+        int pos, m = 0;
+
+        for (pos = 0; pos + blocks[b] <= DECIM_LEN; pos += blocks[b])
+            m += d.process(in + pos, blocks[b], out + m);
+        if (memcmp(out, ref, m * sizeof(short)) != 0)
+        {
+            printf("decimator: blocks of %d differ\n", blocks[b]);
+            failed = 1;
+        }
+    }
+
+    free(in);
+    free(out);
+    free(ref);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t rates[] = { 8000, AUDIO_IN_WIDEBAND, 11025, 22050, 44100, 7999, 12345 };
+    int seconds = 600, failed = 0, i;
+    unsigned seed = 1;
+
+    if (argc == 3 && strcmp(argv[1], "-s") == 0)
+        seconds = atoi(argv[2]);
+    else if (argc != 1)
+        seconds = 0;
+    if (seconds <= 0)
+    {
+        fprintf(stderr, "usage: %s [-s seconds]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d MHz timer, up to %d ticks of interrupt latency, %d s per rate\n",
+        TIMER_HZ / 1000000, MAX_LATENCY, seconds);
+    for (i = 0; i < (int)(sizeof(rates) / sizeof(rates[0])); i++)
+        failed |= run_clock(rates[i], seconds, &seed);
+    failed |= run_decimator();
+
+    return failed;
+}
@@ -0,0 +1,237 @@
+/*
+ * Input conditioning test and benchmark.
+ *
+ * Runs the InputConditioner of src/Conditioner.h over 160 sample blocks of
+ * simulated MCP3201 codes, offset binary around an offset that is not
+ * 2048:
+ *
+ *   dc      a 1 kHz tone with the offset stepping by 200 codes half way,
+ *           AGC off: once settled the output must have no DC left and the
+ *           tone at 16 times its amplitude
+ *   agc     hola.raw twice at 0, -12 and -24 dB, then two seconds of noise
+ *           under the AGC floor: the second time, the speech must come out
+ *           within 6 dB of the same level and not clip, and the gain must
+ *           hold in the noise
+ *
+ * Reports the ns per 160 sample frame with the AGC off and on, against
+ * openlpc_encode() of the same frames, as the share of the frame time the
+ * encoder leaves the device.
+ *
+ *   condtest [-n iterations] hola.raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+#include "AudioIn.h"
+#include "Conditioner.h"
+
+#define RATE        8000
+#define ADC_BITS    12
+#define ADC_OFFSET  2137        /* mid-scale plus a bias, in codes */
+#define SETTLE      (RATE / 2)  /* samples left out of the checks */
+#define NOISE_LEN   (2 * RATE)
+
+static short adc_code(double v)
+{
+    long c = lrint(v);
+
+    return (short)(c < 0 ? 0 : (c > 4095 ? 4095 : c));
+}
+
+/* conditions n samples in frames, like loop() does */
+static void condition(InputConditioner *c, short *x, long n)
+{
+    long i;
+
+    for (i = 0; i + AUDIO_IN_FRAMESIZE <= n; i += AUDIO_IN_FRAMESIZE)
+        c->process(x + i, AUDIO_IN_FRAMESIZE);
+}
+
+/* returns 1 if the DC is not removed or the scale is off */
+static int run_dc()
+{
+    static short x[4 * RATE];
+    InputConditioner c;
+    double amp = 300, sum = 0, sq = 0, db;
+    long n = sizeof(x) / sizeof(x[0]), i, m = 0;
+    int failed = 0;
+
+    for (i = 0; i < n; i++)
+        x[i] = adc_code(ADC_OFFSET + (i >= n / 2 ? 200 : 0) + amp * sin(2 * M_PI * 1000 * i / RATE));
+    c.begin(ADC_BITS, false);
+    condition(&c, x, n);
+
+    /* the second after each settling time, a whole number of periods */
+    for (i = 0; i < n; i++)
+    {
+        if ((i >= SETTLE && i < SETTLE + RATE) || (i >= n / 2 + SETTLE && i < n / 2 + SETTLE + RATE))
+        {
+            sum += x[i];
+            sq += (double)x[i] * x[i];
+            m++;
+        }
+    }
+    sum /= m;
+    db = 10 * log10(sq / m / (16 * amp * 16 * amp / 2));
+    printf("dc   offset %d, then %d codes: %+6.2f left, tone %+5.2f dB from 16x\n",
+        ADC_OFFSET, ADC_OFFSET + 200, sum, db);
+    if (fabs(sum) > 8 || fabs(db) > 0.1)
+    {
+        printf("dc: not removed or scaled\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+/* returns 1 if the AGC doesn't level the speech or pumps up the noise */
+static int run_agc(const short *pcm, long samples)
+{
+    static const int levels[] = { 0, -12, -24 };
+    double out[3];
+    long n = 2 * samples + NOISE_LEN, i;
+    short *x = (short *)malloc(n * sizeof(short));
+    unsigned seed = 1;
+    int failed = 0, l;
+
+    for (l = 0; l < 3; l++)
+    {
+        InputConditioner c;
+        double gain = pow(10, levels[l] / 20.0), sq = 0, in = 0;
+        long clips = 0;
+        int held;
+
+        for (i = 0; i < 2 * samples; i++)
+        {
+            x[i] = adc_code(ADC_OFFSET + pcm[i % samples] * gain / 16);
+            if (i >= samples)
+                in += (double)(pcm[i - samples] * gain) * (pcm[i - samples] * gain);
+        }
+        for (; i < n; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            x[i] = adc_code(ADC_OFFSET + (int)((seed >> 16) % 5) - 2);
+        }
+
+        c.begin(ADC_BITS, true);
+        condition(&c, x, 2 * samples);
+        held = c.gain();
+        condition(&c, x + 2 * samples, n - 2 * samples);
+
+        for (i = samples; i < 2 * samples; i++)
+        {
+            sq += (double)x[i] * x[i];
+            if (x[i] == 32767 || x[i] == -32768)
+                clips++;
+        }
+        in = 10 * log10(in / samples / (32768.0 * 32768.0));
+        out[l] = 10 * log10(sq / samples / (32768.0 * 32768.0));
+        printf("agc  %+3d dB: speech %6.2f dBFS in, %6.2f dBFS out, gain %5.2f, %ld clipped, gain %5.2f after the noise\n",
+            levels[l], in, out[l], held / (double)COND_ONE, clips, c.gain() / (double)COND_ONE);
+
+        if (clips > 0)
+        {
+            printf("agc: clips\n");
+            failed = 1;
+        }
+        if (c.gain() != held)
+        {
+            printf("agc: noise pumped up\n");
+            failed = 1;
+        }
+    }
+    if (fabs(out[2] - out[0]) > 6)
+    {
+        printf("agc: %.2f dB between 0 and -24 dB in\n", out[0] - out[2]);
+        failed = 1;
+    }
+
+    free(x);
+    return failed;
+}
+
+/* ns per frame of the conditioning and of the encoder, the fastest of
+   'iterations' passes over hola.raw */
+static void bench(const short *pcm, long samples, int iterations)
+{
+    long frames = samples / AUDIO_IN_FRAMESIZE, i, f;
+    short *codes = (short *)malloc(frames * AUDIO_IN_FRAMESIZE * sizeof(short));
+    short *x = (short *)malloc(frames * AUDIO_IN_FRAMESIZE * sizeof(short));
+    unsigned char lpc[OPENLPC_MAX_ENCODED_FRAME_SIZE];
+    openlpc_encoder_state *enc = create_openlpc_encoder_state();
+    double best[3] = { 1e30, 1e30, 1e30 };
+    int it, k;
+
+    for (i = 0; i < frames * AUDIO_IN_FRAMESIZE; i++)
+        codes[i] = adc_code(ADC_OFFSET + pcm[i] / 16);
+
+    for (it = 0; it < iterations; it++)
+    {
+        for (k = 0; k < 3; k++)
+        {
+            InputConditioner c;
+            unsigned long long t0;
+
+            /* the encoder gets the frames conditioned */
+            memcpy(x, codes, frames * AUDIO_IN_FRAMESIZE * sizeof(short));
+            c.begin(ADC_BITS, k != 0);
+            if (k == 2)
+            {
+                condition(&c, x, frames * AUDIO_IN_FRAMESIZE);
+                init_openlpc_encoder_state(enc, AUDIO_IN_FRAMESIZE);
+            }
+            t0 = now_ns();
+            for (f = 0; f < frames; f++)
+            {
+                if (k == 2)
+                    openlpc_encode(x + f * AUDIO_IN_FRAMESIZE, lpc, enc);
+                else
+                    c.process(x + f * AUDIO_IN_FRAMESIZE, AUDIO_IN_FRAMESIZE);
+            }
+            t0 = now_ns() - t0;
+            if ((double)t0 / frames < best[k])
+                best[k] = (double)t0 / frames;
+        }
+    }
+
+    printf("per %d sample frame: conditioning %6.0f ns, with AGC %6.0f ns, encoder %6.0f ns (%.1f%% of it)\n",
+        AUDIO_IN_FRAMESIZE, best[0], best[1], best[2], best[1] / best[2] * 100);
+
+    free(codes);
+    free(x);
+    destroy_openlpc_encoder_state(enc);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20, failed = 0;
+    long size;
+    short *pcm;
+
+    if (argc == 4 && strcmp(argv[1], "-n") == 0)
+    {
+        iterations = atoi(argv[2]);
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 2 || iterations <= 0)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] hola.raw\n", argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(argv[1], &size);
+    size /= sizeof(short);
+
+    failed |= run_dc();
+    failed |= run_agc(pcm, size);
+    bench(pcm, size, iterations);
+
+    free(pcm);
+    return failed;
+}
@@ -0,0 +1,57 @@
+/*
+ * Helpers shared by the host tools: a monotonic clock in ns, and whole
+ * files read into memory or written out, exiting with a message on error.
+ */
+
+#ifndef HOSTUTIL_H
+#define HOSTUTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* the whole file, malloc()ed, and its size in bytes */
+static inline unsigned char *load_file(const char *path, long *size)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned char *data;
+
+    if (f == NULL)
+    {
+        fprintf(stderr, "can't open %s\n", path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (unsigned char *)malloc(*size);
+    if (data == NULL || fread(data, 1, *size, f) != (size_t)*size)
+    {
+        fprintf(stderr, "can't read %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+    return data;
+}
+
+static inline void write_file(const char *path, const void *data, long size)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL || fwrite(data, 1, size, f) != (size_t)size)
+    {
+        fprintf(stderr, "can't write %s\n", path);
+        exit(1);
+    }
+    fclose(f);
+}
+
+#endif
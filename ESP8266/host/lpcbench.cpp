@@ -0,0 +1,350 @@
+/*
+ * Host-side benchmark for the OpenLPC codec.
+ *
+ * Replays a raw 8 kHz 16-bit mono file through the encoders and an
+ * encoded .lpc file through the decoders, and reports frames/s and
+ * ns/frame of the fastest of 'iterations' passes for the fixed point
+ * codec, frame by frame and through the batch API, its 16 bit (Q15)
+ * synthesis, and the float reference. When built with OPENLPC_PROFILE it also prints a per-stage breakdown of
+ * the fixed point codec. -o writes what the fixed point encoder made of
+ * the raw file, -d what the fixed point decoder made of the .lpc file,
+ * and -s prints the SNR of the latter against a reference decode.
+ *
+ *   lpcbench [-n iterations] [-f framelen] [-o out.lpc] [-d out.raw] [-s ref.raw]
+ *            hola.raw hola.lpc
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+#include "openlpc_float.h"
+#ifdef OPENLPC_PROFILE
+#include "openlpc_prof.h"
+#endif
+
+typedef struct lpc_codec {
+    const char *name;
+    int kernels;        /* openlpc_set_kernels() backend, -1 for the float codec */
+    openlpc_encoder_state *(*create_encoder)(void);
+    void (*init_encoder)(openlpc_encoder_state *st, int framelen);
+    int  (*encode)(const short *in, unsigned char *out, openlpc_encoder_state *st);
+    int  (*encode_frames)(const short *in, int frames, unsigned char *out, openlpc_encoder_state *st);
+    void (*destroy_encoder)(openlpc_encoder_state *st);
+    openlpc_decoder_state *(*create_decoder)(void);
+    void (*init_decoder)(openlpc_decoder_state *st, int framelen);
+    int  (*decode)(const unsigned char *in, short *out, openlpc_decoder_state *st);
+    int  (*decode_frames)(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st);
+    void (*destroy_decoder)(openlpc_decoder_state *st);
+} lpc_codec;
+
+#define FIXED_CODEC(name, kernels, init_decoder) \
+    { name, kernels, \
+      create_openlpc_encoder_state, init_openlpc_encoder_state, openlpc_encode, openlpc_encode_frames, \
+      destroy_openlpc_encoder_state, \
+      create_openlpc_decoder_state, init_decoder, openlpc_decode, openlpc_decode_frames, \
+      destroy_openlpc_decoder_state }
+
+/* the 16 bit lattice */
+static void init_decoder_q15(openlpc_decoder_state *st, int framelen)
+{
+    init_openlpc_decoder_state_synth(st, framelen, OPENLPC_BITS_38, OPENLPC_SYNTH_Q15);
+}
+
+/* the float openlpc_decode() shifts the parameters in place */
+static int flt_decode_copy(const unsigned char *in, short *out, openlpc_decoder_state *st)
+{
+    unsigned char params[OPENLPC_ENCODED_FRAME_SIZE];
+
+    memcpy(params, in, OPENLPC_ENCODED_FRAME_SIZE);
+    return flt_openlpc_decode(params, out, st);
+}
+
+/* fastest fixed point backend first */
+static const lpc_codec codecs[] = {
+    FIXED_CODEC("fixed/avx2", OPENLPC_KERNELS_AVX2, init_openlpc_decoder_state),
+    FIXED_CODEC("fixed/sse4.1", OPENLPC_KERNELS_SSE41, init_openlpc_decoder_state),
+    FIXED_CODEC("fixed/scalar", OPENLPC_KERNELS_SCALAR, init_openlpc_decoder_state),
+    FIXED_CODEC("fixed/q15", OPENLPC_KERNELS_SCALAR, init_decoder_q15),
+    { "float", -1,
+      flt_create_openlpc_encoder_state, flt_init_openlpc_encoder_state, flt_openlpc_encode, NULL,
+      flt_destroy_openlpc_encoder_state,
+      flt_create_openlpc_decoder_state, flt_init_openlpc_decoder_state, flt_decode_copy, NULL,
+      flt_destroy_openlpc_decoder_state },
+};
+
+#ifdef OPENLPC_PROFILE
+const char *openlpc_prof_name[PROF_COUNT] = {
+    "prefilters", "windowing", "auto_correl2", "durbin",
+    "pitch correl", "pitch pick", "quantization",
+    "unpack", "lattice synthesis"
+};
+unsigned long long openlpc_prof_ns[PROF_COUNT];
+#endif
+
+unsigned long long openlpc_prof_now(void)
+{
+    return now_ns();
+}
+
+/* SNR in dB of n samples of x[] against ref[] */
+static double snr(const short *ref, const short *x, long n)
+{
+    double signal = 0, noise = 0;
+    long i;
+
+    for (i = 0; i < n; i++)
+    {
+        signal += (double)ref[i] * ref[i];
+        noise += (double)(ref[i] - x[i]) * (ref[i] - x[i]);
+    }
+    return noise == 0 ? INFINITY : 10 * log10(signal / noise);
+}
+
+static void report(const char *codec, const char *what, int frames, int framelen, unsigned long long ns)
+{
+    double per_frame = (double)ns / frames;
+
+    printf("%-12s %-12s %8d frames %12.0f frames/s %10.0f ns/frame %8.1fx realtime\n",
+        codec, what, frames, 1e9 / per_frame, per_frame,
+        (1e9 / per_frame) * framelen / 8000.0);
+}
+
+/* encodes the whole file 'iterations' times, frame by frame or in one
+   openlpc_encode_frames() call, returns the ns of the fastest pass */
+static unsigned long long bench_encode(const lpc_codec *c, const short *pcm, int frames, int framelen,
+                                       int iterations, int batch, unsigned char *out)
+{
+    openlpc_encoder_state *st = c->create_encoder();
+    unsigned long long t0, best = ~0ull;
+    int it, i;
+
+    for (it = 0; it < iterations; it++)
+    {
+        t0 = openlpc_prof_now();
+        c->init_encoder(st, framelen);
+        if (batch)
+            c->encode_frames(pcm, frames, out, st);
+        else
+            for (i = 0; i < frames; i++)
+                c->encode(pcm + i * framelen, out + i * OPENLPC_ENCODED_FRAME_SIZE, st);
+        t0 = openlpc_prof_now() - t0;
+        if (t0 < best)
+            best = t0;
+    }
+
+    c->destroy_encoder(st);
+    return best;
+}
+
+/* decodes the whole stream 'iterations' times, frame by frame or in one
+   openlpc_decode_frames() call, returns the ns of the fastest pass */
+static unsigned long long bench_decode(const lpc_codec *c, const unsigned char *lpc, int frames, int framelen,
+                                       int iterations, int batch, short *out)
+{
+    openlpc_decoder_state *st = c->create_decoder();
+    unsigned long long t0, best = ~0ull;
+    int it, i;
+
+    for (it = 0; it < iterations; it++)
+    {
+        t0 = openlpc_prof_now();
+        c->init_decoder(st, framelen);
+        if (batch)
+            c->decode_frames(lpc, frames, out, st);
+        else
+            for (i = 0; i < frames; i++)
+                c->decode(lpc + i * OPENLPC_ENCODED_FRAME_SIZE, out + i * framelen, st);
+        t0 = openlpc_prof_now() - t0;
+        if (t0 < best)
+            best = t0;
+    }
+
+    c->destroy_decoder(st);
+    return best;
+}
+
+/* fixed point state footprint, struct plus heap, for the usual frame lengths */
+static void report_sizes(void)
+{
+    static const int framelens[] = { 160, OPENLPC_FRAMESIZE_1_8, OPENLPC_FRAMESIZE_1_4 };
+    openlpc_encoder_state *enc = create_openlpc_encoder_state();
+    openlpc_decoder_state *dec = create_openlpc_decoder_state();
+    int i;
+
+    printf("fixed        state bytes (struct + heap):");
+    for (i = 0; i < (int)(sizeof(framelens) / sizeof(framelens[0])); i++)
+    {
+        init_openlpc_encoder_state(enc, framelens[i]);
+        init_openlpc_decoder_state(dec, framelens[i]);
+        printf("  %d: encoder %d decoder %d", framelens[i],
+            openlpc_encoder_state_size(enc), openlpc_decoder_state_size(dec));
+    }
+    printf("\n");
+
+    destroy_openlpc_encoder_state(enc);
+    destroy_openlpc_decoder_state(dec);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20;
+    int framelen = 160;
+    const char *raw_path = NULL, *lpc_path = NULL, *out_path = NULL;
+    const char *decoded_path = NULL, *ref_path = NULL;
+    long raw_size, lpc_size;
+    short *pcm, *decoded;
+    unsigned char *lpc, *encoded, *first = NULL;
+    int enc_frames, dec_frames;
+    int i, c;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            framelen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            decoded_path = argv[++i];
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            ref_path = argv[++i];
+        else if (raw_path == NULL)
+            raw_path = argv[i];
+        else if (lpc_path == NULL)
+            lpc_path = argv[i];
+        else
+            break;
+    }
+    if (raw_path == NULL || lpc_path == NULL || i < argc || iterations < 1 || framelen < 2)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [-f framelen] [-o out.lpc] [-d out.raw] [-s ref.raw] file.raw file.lpc\n",
+            argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(raw_path, &raw_size);
+    lpc = load_file(lpc_path, &lpc_size);
+    enc_frames = raw_size / 2 / framelen;
+    dec_frames = lpc_size / OPENLPC_ENCODED_FRAME_SIZE;
+
+    encoded = (unsigned char *)malloc(enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+    decoded = (short *)malloc(dec_frames * framelen * sizeof(short));
+
+    printf("%s: %d frames of %d samples, %s: %d frames, %d iterations\n",
+        raw_path, enc_frames, framelen, lpc_path, dec_frames, iterations);
+    report_sizes();
+
+    for (c = 0; c < (int)(sizeof(codecs) / sizeof(codecs[0])); c++)
+    {
+        unsigned long long ns;
+        int mismatches = 0;
+
+        if (codecs[c].kernels >= 0 && openlpc_set_kernels(codecs[c].kernels) != 0)
+        {
+            printf("%-12s not supported here\n", codecs[c].name);
+            continue;
+        }
+        /* untimed warm-up pass */
+        bench_encode(&codecs[c], pcm, enc_frames, framelen, 1, 0, encoded);
+#ifdef OPENLPC_PROFILE
+        memset(openlpc_prof_ns, 0, sizeof(openlpc_prof_ns));
+#endif
+
+        ns = bench_encode(&codecs[c], pcm, enc_frames, framelen, iterations, 0, encoded);
+        report(codecs[c].name, "encode", enc_frames, framelen, ns);
+
+        ns = bench_decode(&codecs[c], lpc, dec_frames, framelen, iterations, 0, decoded);
+        report(codecs[c].name, "decode", dec_frames, framelen, ns);
+
+        if (codecs[c].encode_frames != NULL)
+        {
+            unsigned char *batch_encoded = (unsigned char *)malloc(enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+            short *batch_decoded = (short *)malloc(dec_frames * framelen * sizeof(short));
+
+            ns = bench_encode(&codecs[c], pcm, enc_frames, framelen, iterations, 1, batch_encoded);
+            report(codecs[c].name, "batch encode", enc_frames, framelen, ns);
+
+            ns = bench_decode(&codecs[c], lpc, dec_frames, framelen, iterations, 1, batch_decoded);
+            report(codecs[c].name, "batch decode", dec_frames, framelen, ns);
+
+            if (memcmp(batch_encoded, encoded, enc_frames * OPENLPC_ENCODED_FRAME_SIZE) != 0 ||
+                memcmp(batch_decoded, decoded, dec_frames * framelen * sizeof(short)) != 0)
+                printf("%-12s MISMATCH between the batch and the per-frame API\n", codecs[c].name);
+            free(batch_encoded);
+            free(batch_decoded);
+        }
+
+        for (i = 0; i < enc_frames && i < dec_frames; i++)
+        {
+            if (memcmp(encoded + i * OPENLPC_ENCODED_FRAME_SIZE, lpc + i * OPENLPC_ENCODED_FRAME_SIZE,
+                       OPENLPC_ENCODED_FRAME_SIZE) != 0)
+                mismatches++;
+        }
+        printf("%-12s encoded frames differing from %s: %d/%d\n", codecs[c].name, lpc_path, mismatches, i);
+
+        if (codecs[c].kernels < 0)
+            continue;
+
+        /* the backends must all give the same output */
+        if (first != NULL)
+        {
+            if (memcmp(encoded, first, enc_frames * OPENLPC_ENCODED_FRAME_SIZE) != 0)
+                printf("%-12s MISMATCH with the first fixed point backend\n", codecs[c].name);
+            continue;
+        }
+        first = (unsigned char *)malloc(enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+        memcpy(first, encoded, enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+
+        if (out_path != NULL)
+            write_file(out_path, encoded, enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+        if (decoded_path != NULL)
+            write_file(decoded_path, decoded, dec_frames * framelen * sizeof(short));
+        if (ref_path != NULL)
+        {
+            long ref_size;
+            short *ref = (short *)load_file(ref_path, &ref_size);
+            long n = ref_size / (long)sizeof(short);
+
+            if (n > (long)dec_frames * framelen)
+                n = (long)dec_frames * framelen;
+            printf("%-12s decode SNR against %s: %.1f dB over %ld samples\n",
+                codecs[c].name, ref_path, snr(ref, decoded, n), n);
+            free(ref);
+        }
+#ifdef OPENLPC_PROFILE
+        /* only the fastest fixed point backend is profiled */
+        break;
+#endif
+    }
+
+#ifdef OPENLPC_PROFILE
+    {
+        unsigned long long total = 0;
+
+        for (i = 0; i < PROF_COUNT; i++)
+            total += openlpc_prof_ns[i];
+
+        printf("\nfixed point per-stage breakdown (ns/frame, instrumented build)\n");
+        for (i = 0; i < PROF_COUNT; i++)
+        {
+            int frames = (i < PROF_UNPACK ? enc_frames : dec_frames) * iterations;
+
+            printf("  %-18s %10.0f  %5.1f%%\n", openlpc_prof_name[i],
+                (double)openlpc_prof_ns[i] / frames, 100.0 * openlpc_prof_ns[i] / total);
+        }
+    }
+#endif
+
+    free(pcm);
+    free(lpc);
+    free(encoded);
+    free(first);
+    free(decoded);
+    return 0;
+}
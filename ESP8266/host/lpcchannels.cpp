@@ -0,0 +1,184 @@
+/*
+ * Benchmark of the multi-channel decoder against one decoder per channel.
+ *
+ * Decodes 'channels' different streams, made of hola.lpc starting at a
+ * different frame for every channel, with openlpc_decode_multi() and with
+ * a single decoder per channel, checks that both give the same samples and
+ * reports the ns per channel and frame and how many real time channels
+ * one core can decode, for each kernel backend. -b takes streams of other
+ * bits per frame (and options), see init_openlpc_multi_decoder_state_bits().
+ *
+ *   lpcchannels [-n iterations] [-f framelen] [-b lpcbits] [-k channels]... hola.lpc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define MAX_COUNTS  16
+
+static const char *backend_names[] = { "scalar", "sse4.1", "avx2" };
+
+/* frame i of every channel, in the layout openlpc_decode_multi() reads */
+static unsigned char *make_streams(const unsigned char *lpc, int frames, int channels, int size)
+{
+    unsigned char *in = (unsigned char *)malloc((size_t)frames * channels * size);
+    int i, c;
+
+    for (i = 0; i < frames; i++)
+        for (c = 0; c < channels; c++)
+            memcpy(in + ((size_t)i * channels + c) * size,
+                   lpc + (size_t)((i + c * 41) % frames) * size, size);
+    return in;
+}
+
+/* decodes every stream with its own decoder, out is frames x channels x framelen;
+   returns the ns of the fastest pass */
+static unsigned long long bench_single(const unsigned char *in, int frames, int channels, int framelen,
+                                       int lpcbits, int iterations, short *out)
+{
+    openlpc_decoder_state **dec = (openlpc_decoder_state **)malloc(channels * sizeof(*dec));
+    unsigned long long t0, best = ~0ull;
+    int it, i, c;
+
+    for (c = 0; c < channels; c++)
+        dec[c] = create_openlpc_decoder_state();
+
+    for (it = 0; it < iterations; it++)
+    {
+        for (c = 0; c < channels; c++)
+            init_openlpc_decoder_state_bits(dec[c], framelen, lpcbits);
+
+        t0 = now_ns();
+        for (i = 0; i < frames; i++)
+            for (c = 0; c < channels; c++)
+                openlpc_decode_frames(in + ((size_t)i * channels + c) * openlpc_encoded_frame_size(lpcbits), 1,
+                                      out + ((size_t)i * channels + c) * framelen, dec[c]);
+        t0 = now_ns() - t0;
+        if (t0 < best)
+            best = t0;
+    }
+
+    for (c = 0; c < channels; c++)
+        destroy_openlpc_decoder_state(dec[c]);
+    free(dec);
+    return best;
+}
+
+/* same with the multi-channel decoder */
+static unsigned long long bench_multi(const unsigned char *in, int frames, int channels, int framelen,
+                                      int lpcbits, int iterations, short *out)
+{
+    openlpc_multi_decoder_state *st = create_openlpc_multi_decoder_state(channels);
+    unsigned long long t0, best = ~0ull;
+    int it, i;
+
+    for (it = 0; it < iterations; it++)
+    {
+        init_openlpc_multi_decoder_state_bits(st, framelen, lpcbits);
+
+        t0 = now_ns();
+        for (i = 0; i < frames; i++)
+            openlpc_decode_multi(in + (size_t)i * channels * openlpc_encoded_frame_size(lpcbits),
+                                 out + (size_t)i * channels * framelen, st);
+        t0 = now_ns() - t0;
+        if (t0 < best)
+            best = t0;
+    }
+
+    destroy_openlpc_multi_decoder_state(st);
+    return best;
+}
+
+static void report(const char *what, int channels, int frames, int framelen, unsigned long long ns)
+{
+    double per_frame = (double)ns / ((double)frames * channels);
+
+    printf("  %-7s %8.0f ns/channel-frame %8.0f channels/core", what, per_frame,
+        framelen / 8000.0 * 1e9 / per_frame);
+}
+
+int main(int argc, char **argv)
+{
+    int counts[MAX_COUNTS] = { 1, 8, 64 };
+    int ncounts = 0;
+    int iterations = 10;
+    int framelen = 160;
+    int lpcbits = OPENLPC_BITS_38, size;
+    const char *lpc_path = NULL;
+    long lpc_size;
+    unsigned char *lpc;
+    int frames, failed = 0;
+    int i, b, n;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            framelen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            lpcbits = strtol(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc && ncounts < MAX_COUNTS)
+            counts[ncounts++] = atoi(argv[++i]);
+        else if (lpc_path == NULL)
+            lpc_path = argv[i];
+        else
+            break;
+    }
+    if (ncounts == 0)
+        ncounts = 3;
+    for (n = 0; n < ncounts; n++)
+        if (counts[n] < 1)
+            break;
+    size = openlpc_encoded_frame_size(lpcbits);
+    if (lpc_path == NULL || i < argc || n < ncounts || iterations < 1 || framelen < 2 || size < 0)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [-f framelen] [-b lpcbits] [-k channels]... file.lpc\n", argv[0]);
+        return 1;
+    }
+
+    lpc = load_file(lpc_path, &lpc_size);
+    frames = lpc_size / size;
+    printf("%s: %d frames of %d samples, lpcbits %#x, %d iterations\n", lpc_path, frames, framelen, lpcbits, iterations);
+
+    for (n = 0; n < ncounts; n++)
+    {
+        int channels = counts[n];
+        unsigned char *in = make_streams(lpc, frames, channels, size);
+        size_t samples = (size_t)frames * channels * framelen;
+        short *ref = (short *)malloc(samples * sizeof(short));
+        short *out = (short *)malloc(samples * sizeof(short));
+        unsigned long long ns;
+
+        for (b = OPENLPC_KERNELS_SCALAR; b <= OPENLPC_KERNELS_AVX2; b++)
+        {
+            if (openlpc_set_kernels(b) != 0)
+                continue;
+
+            printf("%-6s %3d channels", backend_names[b], channels);
+            ns = bench_single(in, frames, channels, framelen, lpcbits, iterations, ref);
+            report("single", channels, frames, framelen, ns);
+            ns = bench_multi(in, frames, channels, framelen, lpcbits, iterations, out);
+            report("multi", channels, frames, framelen, ns);
+
+            if (memcmp(ref, out, samples * sizeof(short)) != 0)
+            {
+                printf("  MISMATCH");
+                failed = 1;
+            }
+            printf("\n");
+        }
+
+        free(in);
+        free(ref);
+        free(out);
+    }
+
+    free(lpc);
+    return failed;
+}
@@ -0,0 +1,322 @@
+/*
+ * Conformance and quality suite for the fixed point codec.
+ *
+ * For each kernel backend the CPU has: encodes hola.raw and compares the
+ * stream byte for byte with hola.lpc, and decodes hola.lpc frame by frame,
+ * in one batch and with the multi-channel decoder, which must all give
+ * the samples of the scalar backend. Then compares the fixed point decode
+ * of hola.lpc with the float reference (openlpc.c.org): segmental SNR over
+ * the voiced frames (the unvoiced ones are random noise in both) and
+ * spectral distortion between the LPC envelopes of the two decodes.
+ * The same for the Q15 lattice (OPENLPC_SYNTH_Q15), and its accuracy
+ * against the Q20 one. Last, the spectral distortion against hola.raw of
+ * the low delay encoder (init_openlpc_encoder_state_low_delay), next to
+ * the one of hola.lpc. Any mismatch, or quality under the limits below,
+ * makes it return 1; run it after every change meant to only make the
+ * codec faster.
+ *
+ *   lpcconform hola.raw hola.lpc
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+#include "openlpc_float.h"
+
+#define FRAMELEN        160     /* of hola.lpc */
+#define ORDER           10      /* of the envelopes for the spectral distortion */
+#define BINS            64      /* up to 4 kHz */
+
+/* limits for the decode against the float reference */
+#define MIN_SEGSNR      8.0     /* dB, voiced frames */
+#define MAX_SD          2.0     /* dB, active frames */
+#define ACTIVE_RMS      100.0   /* frames quieter than this are not measured */
+
+/* limits for the Q15 lattice against the Q20 one */
+#define MIN_Q15_SEGSNR  20.0    /* dB, active frames */
+#define MAX_Q15_SD      0.5     /* dB, active frames */
+
+/* limit for the low delay encoder, over the standard one */
+#define MAX_LD_SD_LOSS  0.5     /* dB, active frames */
+
+static const char *backend_names[] = { "scalar", "sse4.1", "avx2" };
+
+/* frames of a[] that differ from b[] */
+static int diff_frames(const void *a, const void *b, int frames, int size)
+{
+    int i, n = 0;
+
+    for (i = 0; i < frames; i++)
+        n += memcmp((const char *)a + (size_t)i * size, (const char *)b + (size_t)i * size, size) != 0;
+    return n;
+}
+
+static double rms(const short *x, int n)
+{
+    double e = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        e += (double)x[i] * x[i];
+    return sqrt(e / n);
+}
+
+/* SNR of one frame, clamped as usual for segmental SNR */
+static double frame_snr(const short *ref, const short *x, int n)
+{
+    double signal = 0, noise = 0, s;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        signal += (double)ref[i] * ref[i];
+        noise += (double)(ref[i] - x[i]) * (ref[i] - x[i]);
+    }
+    s = noise == 0 ? 35 : 10 * log10(signal / noise);
+    return s < -10 ? -10 : (s > 35 ? 35 : s);
+}
+
+/* power envelope in dB of a Hann windowed frame, from an order ORDER LPC fit */
+static void envelope(const short *x, int n, double *env)
+{
+    double w[FRAMELEN], r[ORDER + 1], a[ORDER + 1], t[ORDER + 1], e;
+    int i, j, b;
+
+    for (i = 0; i < n; i++)
+        w[i] = x[i] * (0.5 - 0.5 * cos(2 * M_PI * i / (n - 1)));
+    for (j = 0; j <= ORDER; j++)
+    {
+        r[j] = 0;
+        for (i = j; i < n; i++)
+            r[j] += w[i] * w[i - j];
+    }
+    r[0] = r[0] * (1 + 1e-9) + 1e-9;    /* keeps durbin stable on silence */
+
+    /* durbin */
+    a[0] = 1;
+    for (j = 1; j <= ORDER; j++)
+        a[j] = 0;
+    e = r[0];
+    for (i = 1; i <= ORDER; i++)
+    {
+        double k = -r[i];
+
+        for (j = 1; j < i; j++)
+            k -= a[j] * r[i - j];
+        k /= e;
+        memcpy(t, a, sizeof(t));
+        for (j = 1; j < i; j++)
+            a[j] = t[j] + k * t[i - j];
+        a[i] = k;
+        e *= 1 - k * k;
+    }
+
+    for (b = 0; b < BINS; b++)
+    {
+        double re = 0, im = 0, f = M_PI * (b + 0.5) / BINS;
+
+        for (j = 0; j <= ORDER; j++)
+        {
+            re += a[j] * cos(f * j);
+            im -= a[j] * sin(f * j);
+        }
+        env[b] = 10 * log10(e / (re * re + im * im) + 1e-9);
+    }
+}
+
+/* rms distance in dB between the envelopes of two frames */
+static double spectral_distortion(const short *ref, const short *x, int n)
+{
+    double e1[BINS], e2[BINS], sum = 0;
+    int b;
+
+    envelope(ref, n, e1);
+    envelope(x, n, e2);
+    for (b = 0; b < BINS; b++)
+        sum += (e1[b] - e2[b]) * (e1[b] - e2[b]);
+    return sqrt(sum / BINS);
+}
+
+/* segmental SNR of x[] against ref[] over the active frames, only the
+   voiced ones if voiced_only, and spectral distortion; prints them and
+   returns 1 if they are not within the limits */
+static int quality(const char *what, const short *ref, const short *x, const unsigned char *lpc,
+                   int frames, int voiced_only, double min_segsnr, double max_sd)
+{
+    double segsnr = 0, sd = 0;
+    int i, snr_frames = 0, active = 0;
+
+    for (i = 0; i < frames; i++)
+    {
+        const short *f = ref + i * FRAMELEN, *y = x + i * FRAMELEN;
+
+        if (rms(f, FRAMELEN) < ACTIVE_RMS)
+            continue;
+        sd += spectral_distortion(f, y, FRAMELEN);
+        active++;
+        if (!voiced_only || (lpc[i * OPENLPC_ENCODED_FRAME_SIZE + 1] & 0x3) == 0x3)
+        {
+            segsnr += frame_snr(f, y, FRAMELEN);
+            snr_frames++;
+        }
+    }
+    segsnr = snr_frames ? segsnr / snr_frames : 0;
+    sd = active ? sd / active : 0;
+
+    printf("%s: segmental SNR %.1f dB over %d %sframes (min %.1f), "
+           "spectral distortion %.2f dB over %d frames (max %.2f)%s\n",
+        what, segsnr, snr_frames, voiced_only ? "voiced " : "", min_segsnr, sd, active, max_sd,
+        segsnr < min_segsnr || sd > max_sd ? " FAILED" : "");
+    return segsnr < min_segsnr || sd > max_sd;
+}
+
+/* mean spectral distortion of x[] against the input over its active frames */
+static double input_distortion(const short *pcm, const short *x, int frames)
+{
+    double sd = 0;
+    int i, active = 0;
+
+    for (i = 0; i < frames; i++)
+    {
+        if (rms(pcm + i * FRAMELEN, FRAMELEN) < ACTIVE_RMS || rms(x + i * FRAMELEN, FRAMELEN) < ACTIVE_RMS)
+            continue;
+        sd += spectral_distortion(pcm + i * FRAMELEN, x + i * FRAMELEN, FRAMELEN);
+        active++;
+    }
+    return active ? sd / active : 0;
+}
+
+int main(int argc, char **argv)
+{
+    long raw_size, lpc_size;
+    short *pcm, *ref, *out, *flt;
+    unsigned char *golden, *lpc, params[OPENLPC_ENCODED_FRAME_SIZE];
+    openlpc_encoder_state *enc;
+    openlpc_decoder_state *dec, *fdec;
+    openlpc_multi_decoder_state *mdec;
+    int frames, enc_frames, failed = 0;
+    double sd, sd_ld;
+    int b, i, n;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s file.raw file.lpc\n", argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(argv[1], &raw_size);
+    golden = load_file(argv[2], &lpc_size);
+    enc_frames = raw_size / 2 / FRAMELEN;
+    frames = lpc_size / OPENLPC_ENCODED_FRAME_SIZE;
+    if (enc_frames != frames)
+    {
+        fprintf(stderr, "%s has %d frames, %s %d\n", argv[1], enc_frames, argv[2], frames);
+        return 1;
+    }
+
+    lpc = (unsigned char *)malloc(lpc_size);
+    ref = (short *)malloc((size_t)frames * FRAMELEN * sizeof(short));
+    out = (short *)malloc((size_t)frames * FRAMELEN * sizeof(short));
+    flt = (short *)malloc((size_t)frames * FRAMELEN * sizeof(short));
+    enc = create_openlpc_encoder_state();
+    dec = create_openlpc_decoder_state();
+    mdec = create_openlpc_multi_decoder_state(1);
+    fdec = flt_create_openlpc_decoder_state();
+
+    printf("%s, %s: %d frames of %d samples\n", argv[1], argv[2], frames, FRAMELEN);
+
+    for (b = OPENLPC_KERNELS_SCALAR; b <= OPENLPC_KERNELS_AVX2; b++)
+    {
+        if (openlpc_set_kernels(b) != 0)
+            continue;
+        printf("%-6s", backend_names[b]);
+
+        init_openlpc_encoder_state(enc, FRAMELEN);
+        for (i = 0; i < frames; i++)
+            openlpc_encode(pcm + i * FRAMELEN, lpc + i * OPENLPC_ENCODED_FRAME_SIZE, enc);
+        n = diff_frames(lpc, golden, frames, OPENLPC_ENCODED_FRAME_SIZE);
+        printf("  encode %s", n ? "DIFFERS" : "bit exact");
+        if (n)
+            printf(" (%d frames)", n);
+        failed |= n != 0;
+
+        init_openlpc_encoder_state(enc, FRAMELEN);
+        openlpc_encode_frames(pcm, frames, lpc, enc);
+        n = diff_frames(lpc, golden, frames, OPENLPC_ENCODED_FRAME_SIZE);
+        printf(", batch %s", n ? "DIFFERS" : "bit exact");
+        failed |= n != 0;
+
+        /* the scalar decode is the reference for the others */
+        init_openlpc_decoder_state(dec, FRAMELEN);
+        for (i = 0; i < frames; i++)
+            openlpc_decode(golden + i * OPENLPC_ENCODED_FRAME_SIZE, out + i * FRAMELEN, dec);
+        if (b == OPENLPC_KERNELS_SCALAR)
+            memcpy(ref, out, (size_t)frames * FRAMELEN * sizeof(short));
+        n = diff_frames(out, ref, frames, FRAMELEN * sizeof(short));
+        printf(", decode %s", n ? "DIFFERS" : "bit exact");
+        failed |= n != 0;
+
+        init_openlpc_decoder_state(dec, FRAMELEN);
+        openlpc_decode_frames(golden, frames, out, dec);
+        n = diff_frames(out, ref, frames, FRAMELEN * sizeof(short));
+        printf(", batch %s", n ? "DIFFERS" : "bit exact");
+        failed |= n != 0;
+
+        init_openlpc_multi_decoder_state(mdec, FRAMELEN);
+        for (i = 0; i < frames; i++)
+            openlpc_decode_multi(golden + i * OPENLPC_ENCODED_FRAME_SIZE, out + i * FRAMELEN, mdec);
+        n = diff_frames(out, ref, frames, FRAMELEN * sizeof(short));
+        printf(", multi %s\n", n ? "DIFFERS" : "bit exact");
+        failed |= n != 0;
+    }
+
+    /* quality against the float reference */
+    flt_init_openlpc_decoder_state(fdec, FRAMELEN);
+    for (i = 0; i < frames; i++)
+    {
+        /* the float decoder shifts the parameters in place */
+        memcpy(params, golden + i * OPENLPC_ENCODED_FRAME_SIZE, OPENLPC_ENCODED_FRAME_SIZE);
+        flt_openlpc_decode(params, flt + i * FRAMELEN, fdec);
+    }
+
+    failed |= quality("q20 against float", flt, ref, golden, frames, 1, MIN_SEGSNR, MAX_SD);
+
+    /* the Q15 lattice, against the float reference and against the Q20 one:
+       both use the same noise, so the waveforms can be compared everywhere */
+    init_openlpc_decoder_state_synth(dec, FRAMELEN, OPENLPC_BITS_38, OPENLPC_SYNTH_Q15);
+    openlpc_decode_frames(golden, frames, out, dec);
+    failed |= quality("q15 against float", flt, out, golden, frames, 1, MIN_SEGSNR, MAX_SD);
+    failed |= quality("q15 against q20", ref, out, golden, frames, 0, MIN_Q15_SEGSNR, MAX_Q15_SD);
+
+    /* the low delay encoder, decoded with its frame length */
+    init_openlpc_encoder_state_low_delay(enc, OPENLPC_FRAMESIZE_LOW_DELAY, OPENLPC_BITS_38);
+    init_openlpc_decoder_state_bits(dec, OPENLPC_FRAMESIZE_LOW_DELAY, OPENLPC_BITS_38);
+    for (i = 0; i < frames * FRAMELEN / OPENLPC_FRAMESIZE_LOW_DELAY; i++)
+    {
+        openlpc_encode(pcm + i * OPENLPC_FRAMESIZE_LOW_DELAY, params, enc);
+        openlpc_decode(params, out + i * OPENLPC_FRAMESIZE_LOW_DELAY, dec);
+    }
+    sd = input_distortion(pcm, ref, frames);
+    sd_ld = input_distortion(pcm, out, frames);
+    printf("low delay against the input: spectral distortion %.2f dB, %d samples %.2f dB (max +%.2f)%s\n",
+        sd_ld, FRAMELEN, sd, MAX_LD_SD_LOSS, sd_ld > sd + MAX_LD_SD_LOSS ? " FAILED" : "");
+    failed |= sd_ld > sd + MAX_LD_SD_LOSS;
+
+    printf("%s\n", failed ? "FAILED" : "passed");
+
+    destroy_openlpc_encoder_state(enc);
+    destroy_openlpc_decoder_state(dec);
+    destroy_openlpc_multi_decoder_state(mdec);
+    flt_destroy_openlpc_decoder_state(fdec);
+    free(pcm);
+    free(golden);
+    free(lpc);
+    free(ref);
+    free(out);
+    free(flt);
+    return failed;
+}
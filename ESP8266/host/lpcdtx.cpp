@@ -0,0 +1,227 @@
+/*
+ * Discontinuous transmission test.
+ *
+ * Encodes a raw 8 kHz 16-bit mono file with openlpc_encode_dtx(), counts
+ * the frames sent, the frames not sent and the gaps they make, and decodes
+ * the stream back with openlpc_decode_cng() in the gaps. With -d the
+ * decoded samples are written to out.raw.
+ *
+ * Then the file is checked with NOISE_LEN samples of white noise before
+ * and after it, and the same noise under it, at the level of a quiet room
+ * but over the smallest gain step of the codec:
+ *
+ *   - the leading silence sends only a silence descriptor every
+ *     OPENLPC_SID_FRAMES frames, from its first frame
+ *   - every frame SPEECH_DB over the noise is sent
+ *   - the trailing silence sends at most the hangover after the speech,
+ *     then only the descriptors, one every OPENLPC_SID_FRAMES frames
+ *   - the comfort noise in the frames not sent is within CNG_DB of the
+ *     noise in
+ *
+ * Exits with 1 if any of them fails.
+ *
+ *   lpcdtx [-f framelen] [-d out.raw] hola.raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define NOISE_LEN   16000       /* samples of silence before and after */
+#define NOISE_RMS   100         /* -50 dBFS */
+#define SPEECH_DB   20          /* over the noise, frames that must be sent */
+#define CNG_DB      3           /* comfort noise level off the noise in */
+#define HANGOVER    960         /* samples sent after speech, VAD_HANGOVER */
+
+/* encodes frames with DTX and decodes them, with comfort noise in the
+   frames not sent; sent[i] is 1 for the frames sent */
+static int dtx(const short *pcm, int frames, int framelen, char *sent, short *out)
+{
+    unsigned char parm[OPENLPC_ENCODED_FRAME_SIZE];
+    openlpc_encoder_state *enc = create_openlpc_encoder_state();
+    openlpc_decoder_state *dec = create_openlpc_decoder_state();
+    int count = 0, i;
+
+    init_openlpc_encoder_state(enc, framelen);
+    init_openlpc_decoder_state(dec, framelen);
+    for (i = 0; i < frames; i++)
+    {
+        sent[i] = openlpc_encode_dtx(pcm + i * framelen, parm, enc) != 0;
+        if (sent[i])
+            openlpc_decode(parm, out + i * framelen, dec);
+        else
+            openlpc_decode_cng(out + i * framelen, dec);
+        count += sent[i];
+    }
+
+    destroy_openlpc_encoder_state(enc);
+    destroy_openlpc_decoder_state(dec);
+    return count;
+}
+
+/* energy of n samples in dB */
+static double level_db(const short *x, int n)
+{
+    double e = 0;
+    int j;
+
+    for (j = 0; j < n; j++)
+        e += (double)x[j] * x[j];
+    return 10 * log10(e / n + 1e-9);
+}
+
+/* checks the silence of frames from to to: after at most 'lead' frames
+   still sent, a descriptor opens it and then comes every
+   OPENLPC_SID_FRAMES frames; adds up the energies of the frames not sent,
+   in and out; returns 1 if the pattern is off */
+static int check_silence(const char *name, const char *sent, int from, int to, int lead,
+    const short *pcm, const short *out, int framelen, double *in_e, double *out_e, int *cng)
+{
+    int first, i, j;
+
+    for (first = from; first < to && sent[first]; first++)
+        ;
+    first--;
+    if (first < from)
+    {
+        printf("%s silence: no descriptor opens it\n", name);
+        return 1;
+    }
+    if (first > from + lead)
+    {
+        printf("%s silence: %d frames sent before the first descriptor\n", name, first - from);
+        return 1;
+    }
+    for (i = first; i < to; i++)
+    {
+        if (sent[i] != ((i - first) % OPENLPC_SID_FRAMES == 0))
+        {
+            printf("%s silence: frame %d %s\n", name, i, sent[i] ? "sent" : "not sent");
+            return 1;
+        }
+        if (!sent[i])
+        {
+            for (j = 0; j < framelen; j++)
+            {
+                *in_e += (double)pcm[i * framelen + j] * pcm[i * framelen + j];
+                *out_e += (double)out[i * framelen + j] * out[i * framelen + j];
+            }
+            (*cng)++;
+        }
+    }
+    printf("%s silence: %d frames, %d sent before the first descriptor, then one every %d\n",
+        name, to - from, first - from, OPENLPC_SID_FRAMES);
+    return 0;
+}
+
+/* hola.raw between and over noise; returns 1 if a check fails */
+static int run_check(const short *pcm, int frames, int framelen)
+{
+    int pad = NOISE_LEN / framelen, total = frames + 2 * pad, hang = (HANGOVER + framelen - 1) / framelen;
+    long n = (long)total * framelen, i;
+    short *in = (short *)malloc(n * sizeof(short));
+    short *out = (short *)malloc(n * sizeof(short));
+    char *sent = (char *)malloc(total);
+    double noise = 20 * log10(NOISE_RMS), in_e = 0, out_e = 0, cng_db;
+    int amp = (int)(NOISE_RMS * sqrt(3.0)), failed = 0, cng = 0, speech = 0, missed = 0, f;
+    unsigned int seed = 1;
+
+    for (i = 0; i < n; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        in[i] = (short)((int)((seed >> 16) % (2 * amp + 1)) - amp);
+        if (i >= (long)pad * framelen && i < (long)(pad + frames) * framelen)
+            in[i] += pcm[i - (long)pad * framelen];
+    }
+    dtx(in, total, framelen, sent, out);
+
+    failed |= check_silence("leading", sent, 0, pad, 0, in, out, framelen, &in_e, &out_e, &cng);
+
+    for (f = 0; f < frames; f++)
+    {
+        if (level_db(pcm + f * framelen, framelen) >= noise + SPEECH_DB)
+        {
+            speech++;
+            if (!sent[pad + f])
+            {
+                printf("speech: frame %d not sent\n", f);
+                missed++;
+            }
+        }
+    }
+    printf("speech: %d frames %d dB over the noise, %d not sent\n", speech, SPEECH_DB, missed);
+    failed |= speech == 0 || missed > 0;
+
+    /* the encoder sees a frame late, so one more for the last speech */
+    failed |= check_silence("trailing", sent, pad + frames, total, hang + 1, in, out, framelen, &in_e, &out_e, &cng);
+
+    cng_db = 10 * log10((out_e + 1e-9) / (in_e + 1e-9));
+    printf("comfort noise: %d frames, %+.2f dB from the noise in\n", cng, cng_db);
+    if (cng == 0 || fabs(cng_db) > CNG_DB)
+    {
+        printf("comfort noise: off the noise level\n");
+        failed = 1;
+    }
+
+    free(in);
+    free(out);
+    free(sent);
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int framelen = 160;
+    const char *raw_path = NULL, *out_path = NULL;
+    long raw_size;
+    short *pcm, *out;
+    char *sent;
+    int frames, count, gaps = 0, failed, i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            framelen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (raw_path == NULL)
+            raw_path = argv[i];
+        else
+            break;
+    }
+    if (raw_path == NULL || i < argc || framelen < 2)
+    {
+        fprintf(stderr, "usage: %s [-f framelen] [-d out.raw] file.raw\n", argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(raw_path, &raw_size);
+    frames = raw_size / 2 / framelen;
+    out = (short *)malloc((size_t)frames * framelen * sizeof(short));
+    sent = (char *)malloc(frames);
+
+    count = dtx(pcm, frames, framelen, sent, out);
+    for (i = 0; i < frames; i++)
+        gaps += !sent[i] && (i == 0 || sent[i - 1]);
+
+    printf("%s: %d frames of %d samples\n", raw_path, frames, framelen);
+    printf("sent %d, not sent %d (%.0f%%) in %d gaps\n", count, frames - count,
+        100.0 * (frames - count) / frames, gaps);
+    printf("%.0f bps continuous, %.0f bps with dtx\n",
+        8000.0 * OPENLPC_ENCODED_FRAME_SIZE * 8 / framelen,
+        8000.0 * OPENLPC_ENCODED_FRAME_SIZE * 8 / framelen * count / frames);
+
+    if (out_path != NULL)
+        write_file(out_path, out, (long)frames * framelen * sizeof(short));
+
+    failed = run_check(pcm, frames, framelen);
+
+    free(pcm);
+    free(out);
+    free(sent);
+    return failed;
+}
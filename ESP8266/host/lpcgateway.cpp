@@ -0,0 +1,517 @@
+/*
+ * LPC <-> PCM transcoding gateway.
+ *
+ * Listens on a TCP port for devices speaking the websocket link format of
+ * AudioLink.cpp over plain TCP: every packet is the link mode byte followed
+ * by one encoded frame (LINK_LPC_*) or by 160 16-bit samples (LINK_RAW),
+ * so the stream needs no other framing. Each packet is answered with the
+ * same mode byte followed by the other side of the codec: the decoded
+ * samples of an LPC frame, or the 160 samples encoded at 38 bits.
+ *
+ * Every session has its own encoder and decoders and is handed, for its
+ * lifetime, to one of 'threads' workers that does its socket I/O and runs
+ * its codecs, so the states never move between threads (-a also pins the
+ * workers to cores). Every 'interval' seconds it prints, per worker, the
+ * sessions, packets/s, the mean and max latency from the packet read to
+ * the reply written, and how busy the worker was; with -v the counters of
+ * every session too. Runs for 'seconds', or until interrupted.
+ *
+ *   lpcgateway [-t threads] [-a] [-i interval] [-d seconds] [-v] [host:]port
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+/* the link modes of AudioLink.cpp */
+enum
+{
+    LINK_RAW,
+    LINK_LPC_160,
+    LINK_LPC_250,
+    LINK_LPC_320,
+    LINK_MODES
+};
+
+static const struct
+{
+    int framelen, lpcbits;
+} link_modes[LINK_MODES] =
+{
+    { 160, OPENLPC_BITS_38 },   /* encoded at 38 bits */
+    { 160, OPENLPC_BITS_38 },
+    { OPENLPC_FRAMESIZE_1_8, OPENLPC_BITS_38 },
+    { OPENLPC_FRAMESIZE_1_4, OPENLPC_BITS_32 },
+};
+
+#define MAX_FRAMELEN    OPENLPC_FRAMESIZE_1_4
+#define IN_BUF          2048
+#define OUT_BUF         16384
+#define MAX_EVENTS      256
+
+typedef std::atomic<unsigned long long> counter;
+
+struct session {
+    int fd, id, port;
+    size_t index;                       /* in worker::sessions */
+    openlpc_encoder_state *enc;
+    openlpc_decoder_state *dec[LINK_MODES];
+    unsigned char in[IN_BUF];
+    int in_len;
+    unsigned char out[OUT_BUF];
+    int out_len, out_pos;
+    int batch;                          /* packets answered in out */
+    unsigned long long rx_ns;           /* when they were read */
+    int writing;                        /* waiting for EPOLLOUT */
+
+    /* written by the worker only, read by the reports */
+    counter packets, lat_sum_ns, lat_max_ns, codec_ns;
+};
+
+struct worker {
+    int epfd;
+    std::thread thread;
+    std::mutex lock;                    /* sessions, against the reports */
+    std::vector<session *> sessions;
+    counter packets, lat_sum_ns, lat_max_ns, busy_ns;
+};
+
+static volatile sig_atomic_t stopping;
+
+/* single writer counters */
+static void add(counter &c, unsigned long long v)
+{
+    c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+static void raise_max(counter &c, unsigned long long v)
+{
+    if (v > c.load(std::memory_order_relaxed))
+        c.store(v, std::memory_order_relaxed);
+}
+
+static int request_size(int mode)
+{
+    if (mode == LINK_RAW)
+        return 1 + link_modes[mode].framelen * sizeof(short);
+    return 1 + openlpc_encoded_frame_size(link_modes[mode].lpcbits);
+}
+
+static int reply_size(int mode)
+{
+    if (mode == LINK_RAW)
+        return 1 + openlpc_encoded_frame_size(link_modes[mode].lpcbits);
+    return 1 + link_modes[mode].framelen * sizeof(short);
+}
+
+static int parse_address(const char *arg, struct sockaddr_in *addr)
+{
+    char host[256];
+    const char *colon = strrchr(arg, ':');
+    struct hostent *he;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_ANY);
+    if (colon != NULL)
+    {
+        if (colon - arg >= (int)sizeof(host))
+            return -1;
+        memcpy(host, arg, colon - arg);
+        host[colon - arg] = 0;
+        he = gethostbyname(host);
+        if (he == NULL || he->h_addrtype != AF_INET)
+            return -1;
+        memcpy(&addr->sin_addr, he->h_addr_list[0], sizeof(addr->sin_addr));
+        arg = colon + 1;
+    }
+    addr->sin_port = htons(atoi(arg));
+    return addr->sin_port != 0 ? 0 : -1;
+}
+
+static void destroy_session(session *s)
+{
+    int m;
+
+    destroy_openlpc_encoder_state(s->enc);
+    for (m = LINK_LPC_160; m < LINK_MODES; m++)
+        destroy_openlpc_decoder_state(s->dec[m]);
+    delete s;
+}
+
+static void close_session(worker *w, session *s)
+{
+    epoll_ctl(w->epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    close(s->fd);
+    {
+        std::lock_guard<std::mutex> guard(w->lock);
+
+        w->sessions[s->index] = w->sessions.back();
+        w->sessions[s->index]->index = s->index;
+        w->sessions.pop_back();
+    }
+    destroy_session(s);
+}
+
+/* answers the complete packets of s->in while there is room in s->out;
+   returns -1 on a bad mode byte */
+static int transcode(session *s)
+{
+    int pos = 0;
+
+    while (pos < s->in_len)
+    {
+        int mode = s->in[pos];
+        unsigned long long t0;
+        unsigned char *reply;
+
+        if (mode >= LINK_MODES)
+            return -1;
+        if (s->in_len - pos < request_size(mode) || s->out_len + reply_size(mode) > OUT_BUF)
+            break;
+
+        t0 = now_ns();
+        reply = s->out + s->out_len;
+        reply[0] = mode;
+        if (mode == LINK_RAW)
+        {
+            short pcm[MAX_FRAMELEN];
+
+            memcpy(pcm, s->in + pos + 1, link_modes[mode].framelen * sizeof(short));
+            openlpc_encode(pcm, reply + 1, s->enc);
+        }
+        else
+        {
+            short pcm[MAX_FRAMELEN];
+
+            openlpc_decode(s->in + pos + 1, pcm, s->dec[mode]);
+            memcpy(reply + 1, pcm, link_modes[mode].framelen * sizeof(short));
+        }
+        add(s->codec_ns, now_ns() - t0);
+
+        pos += request_size(mode);
+        s->out_len += reply_size(mode);
+        s->batch++;
+    }
+
+    s->in_len -= pos;
+    memmove(s->in, s->in + pos, s->in_len);
+    return 0;
+}
+
+/* writes s->out; once it is all out, accounts for the latency of the
+   packets it answered and answers the ones left in s->in */
+static int flush(worker *w, session *s)
+{
+    while (s->out_len > 0)
+    {
+        while (s->out_pos < s->out_len)
+        {
+            ssize_t n = write(s->fd, s->out + s->out_pos, s->out_len - s->out_pos);
+
+            if (n < 0 && errno == EAGAIN)
+            {
+                if (!s->writing)
+                {
+                    struct epoll_event ev;
+
+                    ev.events = EPOLLOUT;
+                    ev.data.ptr = s;
+                    epoll_ctl(w->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+                    s->writing = 1;
+                }
+                return 0;
+            }
+            if (n <= 0)
+                return -1;
+            s->out_pos += n;
+        }
+
+        unsigned long long lat = now_ns() - s->rx_ns;
+
+        add(s->packets, s->batch);
+        add(s->lat_sum_ns, lat * s->batch);
+        raise_max(s->lat_max_ns, lat);
+        add(w->packets, s->batch);
+        add(w->lat_sum_ns, lat * s->batch);
+        raise_max(w->lat_max_ns, lat);
+        s->out_len = s->out_pos = s->batch = 0;
+
+        if (transcode(s) < 0)
+            return -1;
+    }
+
+    if (s->writing)
+    {
+        struct epoll_event ev;
+
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = s;
+        epoll_ctl(w->epfd, EPOLL_CTL_MOD, s->fd, &ev);
+        s->writing = 0;
+    }
+    return 0;
+}
+
+static int serve(worker *w, session *s)
+{
+    ssize_t n = read(s->fd, s->in + s->in_len, IN_BUF - s->in_len);
+
+    if (n < 0 && errno == EAGAIN)
+        return 0;
+    if (n <= 0)
+        return -1;
+    s->in_len += n;
+    s->rx_ns = now_ns();
+    if (transcode(s) < 0)
+        return -1;
+    return flush(w, s);
+}
+
+static void run_worker(worker *w)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int i, n;
+
+    while (!stopping)
+    {
+        unsigned long long t0;
+
+        n = epoll_wait(w->epfd, events, MAX_EVENTS, 100);
+        t0 = now_ns();
+        for (i = 0; i < n; i++)
+        {
+            session *s = (session *)events[i].data.ptr;
+            int err = (events[i].events & EPOLLERR) != 0;
+
+            if (!err && (events[i].events & EPOLLOUT))
+                err = flush(w, s) < 0;
+            else if (!err && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+                err = serve(w, s) < 0;
+            if (err)
+                close_session(w, s);
+        }
+        add(w->busy_ns, now_ns() - t0);
+    }
+
+    std::lock_guard<std::mutex> guard(w->lock);
+    for (i = 0; i < (int)w->sessions.size(); i++)
+        close(w->sessions[i]->fd);
+}
+
+static session *create_session(int fd, int id, int port)
+{
+    session *s = new session();
+    int m;
+
+    s->fd = fd;
+    s->id = id;
+    s->port = port;
+    s->enc = create_openlpc_encoder_state();
+    init_openlpc_encoder_state_bits(s->enc, link_modes[LINK_RAW].framelen, link_modes[LINK_RAW].lpcbits);
+    s->dec[LINK_RAW] = NULL;
+    for (m = LINK_LPC_160; m < LINK_MODES; m++)
+    {
+        s->dec[m] = create_openlpc_decoder_state();
+        init_openlpc_decoder_state_bits(s->dec[m], link_modes[m].framelen, link_modes[m].lpcbits);
+    }
+    return s;
+}
+
+static void report(std::vector<worker> &workers, unsigned long long elapsed_ns, int verbose)
+{
+    size_t i, j;
+
+    for (i = 0; i < workers.size(); i++)
+    {
+        worker *w = &workers[i];
+        unsigned long long packets = w->packets.exchange(0);
+        unsigned long long lat_sum = w->lat_sum_ns.exchange(0);
+        unsigned long long lat_max = w->lat_max_ns.exchange(0);
+        unsigned long long busy = w->busy_ns.exchange(0);
+        std::lock_guard<std::mutex> guard(w->lock);
+
+        printf("worker %2d: %5d sessions %8.0f packets/s  latency mean %7.1f us max %8.1f us  busy %5.1f%%\n",
+            (int)i, (int)w->sessions.size(), packets * 1e9 / elapsed_ns,
+            packets ? lat_sum / 1e3 / packets : 0.0, lat_max / 1e3, 100.0 * busy / elapsed_ns);
+
+        if (!verbose)
+            continue;
+        for (j = 0; j < w->sessions.size(); j++)
+        {
+            session *s = w->sessions[j];
+            unsigned long long p = s->packets.load(std::memory_order_relaxed);
+
+            printf("  session %6d port %5d: %9llu packets  latency mean %7.1f us max %8.1f us  codec %6.1f us/packet\n",
+                s->id, s->port, p, p ? s->lat_sum_ns.load(std::memory_order_relaxed) / 1e3 / p : 0.0,
+                s->lat_max_ns.load(std::memory_order_relaxed) / 1e3,
+                p ? s->codec_ns.load(std::memory_order_relaxed) / 1e3 / p : 0.0);
+        }
+    }
+    fflush(stdout);
+}
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int nthreads = (int)std::thread::hardware_concurrency();
+    int pin = 0, verbose = 0;
+    double interval = 5, seconds = 0;
+    const char *address = NULL;
+    struct sockaddr_in addr;
+    struct rlimit rl;
+    unsigned long long start, last, now;
+    int fd, one = 1, next_id = 0;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            nthreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-a") == 0)
+            pin = 1;
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            interval = atof(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0)
+            verbose = 1;
+        else if (address == NULL)
+            address = argv[i];
+        else
+            break;
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (address == NULL || i < argc || interval <= 0 || seconds < 0 || parse_address(address, &addr) < 0)
+    {
+        fprintf(stderr, "usage: %s [-t threads] [-a] [-i interval] [-d seconds] [-v] [host:]port\n", argv[0]);
+        return 1;
+    }
+
+    /* a descriptor per session */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0)
+    {
+        fprintf(stderr, "can't listen on %s\n", address);
+        return 1;
+    }
+
+    std::vector<worker> workers(nthreads);
+
+    for (i = 0; i < nthreads; i++)
+    {
+        worker *w = &workers[i];
+
+        w->epfd = epoll_create1(0);
+        w->thread = std::thread(run_worker, w);
+        if (pin)
+        {
+            cpu_set_t cpus;
+
+            CPU_ZERO(&cpus);
+            CPU_SET(i % std::thread::hardware_concurrency(), &cpus);
+            pthread_setaffinity_np(w->thread.native_handle(), sizeof(cpus), &cpus);
+        }
+    }
+
+    printf("listening on %s, %d workers\n", address, nthreads);
+    fflush(stdout);
+
+    start = last = now_ns();
+    while (!stopping)
+    {
+        struct epoll_event ev;
+        struct sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int c;
+
+        now = now_ns();
+        if (seconds > 0 && now - start >= seconds * 1e9)
+            break;
+        if (now - last >= interval * 1e9)
+        {
+            report(workers, now - last, verbose);
+            last = now;
+        }
+
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+        c = accept(fd, (struct sockaddr *)&peer, &len);
+        if (c < 0)
+            continue;
+        fcntl(c, F_SETFL, fcntl(c, F_GETFL) | O_NONBLOCK);
+        setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        /* the session stays on this worker until it closes */
+        worker *w = &workers[next_id % nthreads];
+        session *s = create_session(c, next_id++, ntohs(peer.sin_port));
+
+        {
+            std::lock_guard<std::mutex> guard(w->lock);
+
+            s->index = w->sessions.size();
+            w->sessions.push_back(s);
+        }
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = s;
+        epoll_ctl(w->epfd, EPOLL_CTL_ADD, c, &ev);
+    }
+
+    stopping = 1;
+    for (i = 0; i < nthreads; i++)
+        workers[i].thread.join();
+    now = now_ns();
+    if (now > last)
+        report(workers, now - last, verbose);
+    printf("%d sessions served\n", next_id);
+
+    close(fd);
+    for (i = 0; i < nthreads; i++)
+    {
+        worker *w = &workers[i];
+        size_t j;
+
+        for (j = 0; j < w->sessions.size(); j++)
+            destroy_session(w->sessions[j]);
+        close(w->epfd);
+    }
+    return 0;
+}
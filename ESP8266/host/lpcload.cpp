@@ -0,0 +1,361 @@
+/*
+ * Load generator for lpcgateway.
+ *
+ * Opens 'sessions' TCP connections to the gateway, spread over 'threads'
+ * threads, and has each replay hola.lpc the way a device sends it in
+ * LINK_LPC_160 mode: one packet every 20 ms, the sessions spread evenly
+ * over the 20 ms, the file looping. The decoded samples the gateway sends
+ * back for the first pass over the file are checked against a local
+ * decode. Reports the packets sent and answered, the replies that came
+ * too late to be played (after the next packet was due) and the round trip
+ * percentiles. With -x every session sends its next packet as soon as the
+ * reply comes instead, for the throughput of the gateway.
+ *
+ *   lpcload [-c sessions] [-t threads] [-d seconds] [-x] [host:]port hola.lpc
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define FRAMELEN        160
+#define LINK_LPC_160    1           /* the link mode of AudioLink.cpp */
+#define PERIOD_NS       (FRAMELEN * 1000000000ull / 8000)
+#define REQUEST_SIZE    (1 + OPENLPC_ENCODED_FRAME_SIZE)
+#define REPLY_SIZE      (1 + FRAMELEN * sizeof(short))
+#define IN_FLIGHT       64          /* packets sent and not answered yet */
+#define BUCKET_NS       10000       /* round trip histogram resolution */
+#define BUCKETS         20000
+#define MAX_EVENTS      256
+
+struct load_input {
+    const unsigned char *lpc;
+    int frames;
+    const short *ref;               /* local decode of lpc */
+    struct sockaddr_in addr;
+    int flat_out;
+    unsigned long long start, end;
+};
+
+struct device {
+    int fd;
+    unsigned long long next_ns;     /* when the next packet is due */
+    unsigned long long sent_ns[IN_FLIGHT];
+    int sent, answered;
+    unsigned char in[REPLY_SIZE * 4];
+    int in_len;
+};
+
+struct load_stats {
+    unsigned long long sent, answered, late, mismatched, stalled, failed;
+    std::vector<unsigned> rtt;      /* histogram, BUCKET_NS per bucket */
+    unsigned long long rtt_max;
+};
+
+static int parse_address(const char *arg, struct sockaddr_in *addr)
+{
+    char host[256] = "127.0.0.1";
+    const char *colon = strrchr(arg, ':');
+    struct hostent *he;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    if (colon != NULL)
+    {
+        if (colon - arg >= (int)sizeof(host))
+            return -1;
+        memcpy(host, arg, colon - arg);
+        host[colon - arg] = 0;
+        arg = colon + 1;
+    }
+    he = gethostbyname(host);
+    if (he == NULL || he->h_addrtype != AF_INET)
+        return -1;
+    memcpy(&addr->sin_addr, he->h_addr_list[0], sizeof(addr->sin_addr));
+    addr->sin_port = htons(atoi(arg));
+    return addr->sin_port != 0 ? 0 : -1;
+}
+
+static void send_packet(const load_input *in, device *d, load_stats *st, unsigned long long now)
+{
+    unsigned char packet[REQUEST_SIZE];
+
+    if (d->sent - d->answered >= IN_FLIGHT)
+    {
+        st->stalled++;
+        return;
+    }
+    packet[0] = LINK_LPC_160;
+    memcpy(packet + 1, in->lpc + (d->sent % in->frames) * OPENLPC_ENCODED_FRAME_SIZE, OPENLPC_ENCODED_FRAME_SIZE);
+    if (write(d->fd, packet, REQUEST_SIZE) != REQUEST_SIZE)
+    {
+        st->stalled++;
+        return;
+    }
+    d->sent_ns[d->sent % IN_FLIGHT] = now;
+    d->sent++;
+    st->sent++;
+}
+
+/* reads the replies of d; returns -1 when the gateway went away */
+static int receive(const load_input *in, device *d, load_stats *st, unsigned long long now)
+{
+    ssize_t n = read(d->fd, d->in + d->in_len, sizeof(d->in) - d->in_len);
+    int pos = 0;
+
+    if (n < 0 && errno == EAGAIN)
+        return 0;
+    if (n <= 0)
+        return -1;
+    d->in_len += n;
+
+    while (d->in_len - pos >= (int)REPLY_SIZE)
+    {
+        const unsigned char *reply = d->in + pos;
+        unsigned long long rtt = now - d->sent_ns[d->answered % IN_FLIGHT];
+
+        if (reply[0] != LINK_LPC_160 ||
+            (d->answered < in->frames &&
+             memcmp(reply + 1, in->ref + d->answered * FRAMELEN, FRAMELEN * sizeof(short)) != 0))
+            st->mismatched++;
+        if (rtt > PERIOD_NS)
+            st->late++;
+        st->rtt[rtt / BUCKET_NS < BUCKETS ? rtt / BUCKET_NS : BUCKETS - 1]++;
+        if (rtt > st->rtt_max)
+            st->rtt_max = rtt;
+        st->answered++;
+        d->answered++;
+        pos += REPLY_SIZE;
+
+        if (in->flat_out && now < in->end)
+            send_packet(in, d, st, now);
+    }
+    d->in_len -= pos;
+    memmove(d->in, d->in + pos, d->in_len);
+    return 0;
+}
+
+static void run_devices(const load_input *in, int first, int count, int sessions, load_stats *st)
+{
+    std::vector<device> devices(count);
+    struct epoll_event events[MAX_EVENTS];
+    int epfd = epoll_create1(0);
+    int one = 1;
+    int i, n;
+
+    st->rtt.assign(BUCKETS, 0);
+    for (i = 0; i < count; i++)
+    {
+        device *d = &devices[i];
+        struct epoll_event ev;
+
+        d->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (d->fd < 0 || connect(d->fd, (struct sockaddr *)&in->addr, sizeof(in->addr)) < 0)
+        {
+            if (d->fd >= 0)
+                close(d->fd);
+            d->fd = -1;
+            st->failed++;
+            continue;
+        }
+        setsockopt(d->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(d->fd, F_SETFL, fcntl(d->fd, F_GETFL) | O_NONBLOCK);
+        /* the sessions spread over the period */
+        d->next_ns = in->start + PERIOD_NS * (first + i) / sessions;
+        ev.events = EPOLLIN;
+        ev.data.ptr = d;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, d->fd, &ev);
+    }
+
+    for (;;)
+    {
+        unsigned long long now = now_ns(), next = in->end;
+        int timeout;
+
+        if (now >= in->end)
+            break;
+        for (i = 0; i < count; i++)
+        {
+            device *d = &devices[i];
+
+            if (d->fd < 0)
+                continue;
+            if (in->flat_out)
+            {
+                /* the first packet, the replies send the others */
+                if (d->sent == 0 && now >= d->next_ns)
+                    send_packet(in, d, st, now);
+            }
+            else
+            {
+                while (now >= d->next_ns)
+                {
+                    send_packet(in, d, st, now);
+                    d->next_ns += PERIOD_NS;
+                }
+            }
+            if (d->sent == 0 || !in->flat_out)
+                if (d->next_ns < next)
+                    next = d->next_ns;
+        }
+
+        timeout = next > now ? (int)((next - now + 999999) / 1000000) : 0;
+        n = epoll_wait(epfd, events, MAX_EVENTS, timeout);
+        now = now_ns();
+        for (i = 0; i < n; i++)
+        {
+            device *d = (device *)events[i].data.ptr;
+
+            if (receive(in, d, st, now) < 0)
+            {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, d->fd, NULL);
+                close(d->fd);
+                d->fd = -1;
+                st->failed++;
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++)
+        if (devices[i].fd >= 0)
+            close(devices[i].fd);
+    close(epfd);
+}
+
+static double percentile(const std::vector<unsigned> &rtt, unsigned long long total, double p)
+{
+    unsigned long long sum = 0;
+    int i;
+
+    for (i = 0; i < BUCKETS; i++)
+    {
+        sum += rtt[i];
+        if (sum >= total * p)
+            break;
+    }
+    return (i + 1) * BUCKET_NS / 1e3;
+}
+
+int main(int argc, char **argv)
+{
+    int sessions = 1000, nthreads = 4;
+    double seconds = 10;
+    const char *address = NULL, *lpc_path = NULL;
+    long lpc_size;
+    load_input in;
+    load_stats total;
+    struct rlimit rl;
+    openlpc_decoder_state *dec;
+    short *ref;
+    int i;
+
+    in.flat_out = 0;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            sessions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            nthreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "-x") == 0)
+            in.flat_out = 1;
+        else if (address == NULL)
+            address = argv[i];
+        else if (lpc_path == NULL)
+            lpc_path = argv[i];
+        else
+            break;
+    }
+    if (nthreads > sessions)
+        nthreads = sessions;
+    if (address == NULL || lpc_path == NULL || i < argc || sessions < 1 || nthreads < 1 || seconds <= 0 ||
+        parse_address(address, &in.addr) < 0)
+    {
+        fprintf(stderr, "usage: %s [-c sessions] [-t threads] [-d seconds] [-x] [host:]port file.lpc\n", argv[0]);
+        return 1;
+    }
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    in.lpc = load_file(lpc_path, &lpc_size);
+    in.frames = lpc_size / OPENLPC_ENCODED_FRAME_SIZE;
+    ref = (short *)malloc((size_t)in.frames * FRAMELEN * sizeof(short));
+    dec = create_openlpc_decoder_state();
+    init_openlpc_decoder_state(dec, FRAMELEN);
+    openlpc_decode_frames(in.lpc, in.frames, ref, dec);
+    destroy_openlpc_decoder_state(dec);
+    in.ref = ref;
+
+    /* time for the connections before the first packet */
+    in.start = now_ns() + 500000000ull + sessions * 20000ull;
+    in.end = in.start + (unsigned long long)(seconds * 1e9);
+
+    std::vector<std::thread> threads;
+    std::vector<load_stats> stats(nthreads);
+
+    for (i = 0; i < nthreads; i++)
+    {
+        int first = sessions * i / nthreads, count = sessions * (i + 1) / nthreads - first;
+
+        stats[i] = load_stats();
+        threads.push_back(std::thread(run_devices, &in, first, count, sessions, &stats[i]));
+    }
+    for (i = 0; i < nthreads; i++)
+        threads[i].join();
+
+    total = load_stats();
+    total.rtt.assign(BUCKETS, 0);
+    for (i = 0; i < nthreads; i++)
+    {
+        int b;
+
+        total.sent += stats[i].sent;
+        total.answered += stats[i].answered;
+        total.late += stats[i].late;
+        total.mismatched += stats[i].mismatched;
+        total.stalled += stats[i].stalled;
+        total.failed += stats[i].failed;
+        if (stats[i].rtt_max > total.rtt_max)
+            total.rtt_max = stats[i].rtt_max;
+        for (b = 0; b < BUCKETS; b++)
+            total.rtt[b] += stats[i].rtt[b];
+    }
+
+    printf("%s: %d sessions on %d threads for %.1f s, %s\n", address, sessions, nthreads, seconds,
+        in.flat_out ? "flat out" : "one packet per 20 ms");
+    printf("sent %llu, answered %llu (%.0f/s, %.0f realtime sessions), late %llu, not sent %llu, failed sessions %llu\n",
+        total.sent, total.answered, total.answered / seconds, total.answered / seconds / (1e9 / PERIOD_NS),
+        total.late, total.stalled, total.failed);
+    if (total.answered > 0)
+        printf("round trip p50 %.0f us, p99 %.0f us, p99.9 %.0f us, max %.0f us\n",
+            percentile(total.rtt, total.answered, 0.5), percentile(total.rtt, total.answered, 0.99),
+            percentile(total.rtt, total.answered, 0.999), total.rtt_max / 1e3);
+    printf("%s\n", total.mismatched == 0 ? "bit-exact" : "MISMATCH");
+
+    free((void *)in.lpc);
+    free(ref);
+    return total.mismatched != 0 || total.failed != 0 || total.answered == 0;
+}
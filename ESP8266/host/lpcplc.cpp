@@ -0,0 +1,216 @@
+/*
+ * Packet loss concealment test.
+ *
+ * Decodes hola.lpc dropping frames at random, in bursts of 'burst' frames,
+ * for each loss rate, once with openlpc_decode_lost() in place of the lost
+ * frames and once with silence, and reports how far the frame energies are
+ * from the decode without losses, in dB. At every rate the concealed
+ * frames must come closer than silence. Then, after the loudest frame, a
+ * burst of BURST frames is lost: the first must keep the level of the last
+ * frame decoded, and the last TAIL must have faded to the comfort noise
+ * level, that of the quietest frame decoded before it. Exits with 1 if
+ * either fails. With -d the concealed samples of the last loss rate are
+ * written to out.raw.
+ *
+ *   lpcplc [-f framelen] [-b burst] [-l percent]... [-d out.raw] hola.lpc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define MAX_RATES   16
+#define BURST       40
+#define TAIL        10
+#define MAX_FADE    6           /* dB the levels may be off */
+
+/* the same losses on every run */
+static unsigned int rnd_state;
+
+static int rnd_percent(void)
+{
+    rnd_state = rnd_state * 1103515245 + 12345;
+    return (rnd_state >> 16) % 100;
+}
+
+/* energy of a frame in dB, floored at 10 of rms */
+static double frame_db(const short *x, int framelen)
+{
+    double e = 100;
+    int j;
+
+    for (j = 0; j < framelen; j++)
+        e += (double)x[j] * x[j] / framelen;
+    return 10 * log10(e);
+}
+
+/* mean distance between the frame energies of a and b, in dB */
+static double energy_distance(const short *a, const short *b, int frames, int framelen)
+{
+    double sum = 0;
+    int i;
+
+    for (i = 0; i < frames; i++)
+        sum += fabs(frame_db(a + i * framelen, framelen) - frame_db(b + i * framelen, framelen));
+    return sum / frames;
+}
+
+/* loses BURST frames after the loudest one; returns 1 if the first doesn't
+   keep its level or the last TAIL don't reach the comfort noise */
+static int run_burst(const unsigned char *lpc, const short *ref, int frames, int framelen,
+    openlpc_decoder_state *dec)
+{
+    short *out = (short *)malloc((size_t)BURST * framelen * sizeof(short));
+    double last, first, quiet, tail = 0;
+    int loud = 0, i;
+
+    for (i = 1; i < frames; i++)
+        if (frame_db(ref + i * framelen, framelen) > frame_db(ref + loud * framelen, framelen))
+            loud = i;
+    quiet = frame_db(ref, framelen);
+    for (i = 1; i <= loud; i++)
+        if (frame_db(ref + i * framelen, framelen) < quiet)
+            quiet = frame_db(ref + i * framelen, framelen);
+    last = frame_db(ref + loud * framelen, framelen);
+
+    init_openlpc_decoder_state(dec, framelen);
+    for (i = 0; i <= loud; i++)
+        openlpc_decode(lpc + i * OPENLPC_ENCODED_FRAME_SIZE, out, dec);
+    for (i = 0; i < BURST; i++)
+        openlpc_decode_lost(out + i * framelen, dec);
+
+    first = frame_db(out, framelen);
+    for (i = BURST - TAIL; i < BURST; i++)
+        tail += frame_db(out + i * framelen, framelen) / TAIL;
+    free(out);
+
+    printf("burst of %d after frame %d (%.1f dB): first %.1f dB, last %d %.1f dB, comfort noise %.1f dB\n",
+        BURST, loud, last, first, TAIL, tail, quiet);
+    if (fabs(first - last) > MAX_FADE)
+    {
+        printf("burst: first frame off the last one decoded\n");
+        return 1;
+    }
+    if (fabs(tail - quiet) > MAX_FADE)
+    {
+        printf("burst: doesn't fade to the comfort noise\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int rates[MAX_RATES] = { 1, 5, 10, 20 };
+    int nrates = 0;
+    int framelen = 160, burst = 1;
+    const char *lpc_path = NULL, *out_path = NULL;
+    long lpc_size;
+    unsigned char *lpc;
+    char *lost;
+    short *ref, *plc, *mute;
+    openlpc_decoder_state *dec;
+    int frames, i, n, left, failed = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            framelen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            burst = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc && nrates < MAX_RATES)
+            rates[nrates++] = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else if (lpc_path == NULL)
+            lpc_path = argv[i];
+        else
+            break;
+    }
+    if (nrates == 0)
+        nrates = 4;
+    for (n = 0; n < nrates; n++)
+        if (rates[n] < 0 || rates[n] > 100)
+            break;
+    if (lpc_path == NULL || i < argc || n < nrates || framelen < 2 || burst < 1)
+    {
+        fprintf(stderr, "usage: %s [-f framelen] [-b burst] [-l percent]... [-d out.raw] file.lpc\n", argv[0]);
+        return 1;
+    }
+
+    lpc = load_file(lpc_path, &lpc_size);
+    frames = lpc_size / OPENLPC_ENCODED_FRAME_SIZE;
+    lost = (char *)malloc(frames);
+    ref = (short *)malloc((size_t)frames * framelen * sizeof(short));
+    plc = (short *)malloc((size_t)frames * framelen * sizeof(short));
+    mute = (short *)malloc((size_t)frames * framelen * sizeof(short));
+    dec = create_openlpc_decoder_state();
+
+    init_openlpc_decoder_state(dec, framelen);
+    openlpc_decode_frames(lpc, frames, ref, dec);
+
+    printf("%s: %d frames of %d samples, bursts of %d\n", lpc_path, frames, framelen, burst);
+
+    for (n = 0; n < nrates; n++)
+    {
+        double muted, concealed;
+        int count = 0;
+
+        /* a burst starts with a probability that loses rates[n]% of the frames */
+        rnd_state = 1;
+        for (i = 0, left = 0; i < frames; i++)
+        {
+            if (left == 0 && rnd_percent() * burst < rates[n])
+                left = burst;
+            lost[i] = left > 0;
+            if (left > 0)
+                left--;
+            count += lost[i];
+        }
+
+        init_openlpc_decoder_state(dec, framelen);
+        for (i = 0; i < frames; i++)
+        {
+            if (lost[i])
+                openlpc_decode_lost(plc + i * framelen, dec);
+            else
+                openlpc_decode(lpc + i * OPENLPC_ENCODED_FRAME_SIZE, plc + i * framelen, dec);
+        }
+
+        init_openlpc_decoder_state(dec, framelen);
+        for (i = 0; i < frames; i++)
+        {
+            if (lost[i])
+                memset(mute + i * framelen, 0, framelen * sizeof(short));
+            else
+                openlpc_decode(lpc + i * OPENLPC_ENCODED_FRAME_SIZE, mute + i * framelen, dec);
+        }
+
+        muted = energy_distance(ref, mute, frames, framelen);
+        concealed = energy_distance(ref, plc, frames, framelen);
+        printf("%3d%% lost (%3d frames): muted %5.2f dB, concealed %5.2f dB\n", rates[n], count,
+            muted, concealed);
+        if (count > 0 && concealed >= muted)
+        {
+            printf("%d%%: concealed no closer than silence\n", rates[n]);
+            failed = 1;
+        }
+    }
+
+    if (out_path != NULL)
+        write_file(out_path, plc, (long)frames * framelen * sizeof(short));
+
+    failed |= run_burst(lpc, ref, frames, framelen, dec);
+
+    destroy_openlpc_decoder_state(dec);
+    free(lpc);
+    free(lost);
+    free(ref);
+    free(plc);
+    free(mute);
+    return failed;
+}
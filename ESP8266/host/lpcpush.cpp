@@ -0,0 +1,153 @@
+/*
+ * Push encoder test.
+ *
+ * Feeds hola.raw to openlpc_encoder_push() in blocks of each size, checks
+ * the stream is the one openlpc_encode() gives frame by frame (and with
+ * openlpc_encoder_push_dtx(), the one of openlpc_encode_dtx()), and reports
+ * the mean and the worst time of a call, against the time of a whole
+ * frame: the worst call is the one that completes a frame, which is left
+ * with the analysis only.
+ *
+ *   lpcpush [-f framelen] [-n iterations] [-b block]... hola.raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define MAX_BLOCKS  16
+
+/* pushes n samples in blocks of 'block'; returns the bytes written and
+   the mean and worst ns per call of the fastest of 'iterations' passes */
+static long push_all(const short *pcm, long n, int block, int dtx, int framelen, int iterations,
+                     unsigned char *out, openlpc_encoder_state *enc, double *mean_ns, double *worst_ns)
+{
+    long len = 0;
+    int it;
+
+    *mean_ns = *worst_ns = 1e30;
+    for (it = 0; it < iterations; it++)
+    {
+        unsigned long long total = 0, worst = 0;
+        long calls = 0, i;
+
+        init_openlpc_encoder_state(enc, framelen);
+        len = 0;
+        for (i = 0; i < n; i += block, calls++)
+        {
+            int m = n - i < block ? n - i : block;
+            unsigned long long t0 = now_ns(), t;
+
+            if (dtx)
+                len += openlpc_encoder_push_dtx(pcm + i, m, out + len, enc);
+            else
+                len += openlpc_encoder_push(pcm + i, m, out + len, enc);
+            t = now_ns() - t0;
+            total += t;
+            if (t > worst)
+                worst = t;
+        }
+        if ((double)total / calls < *mean_ns)
+            *mean_ns = (double)total / calls;
+        if (worst < *worst_ns)
+            *worst_ns = worst;
+    }
+    return len;
+}
+
+int main(int argc, char **argv)
+{
+    int blocks[MAX_BLOCKS] = { 1, 7, 32, 160, 1000 };
+    int nblocks = 0;
+    int framelen = 160, iterations = 10;
+    const char *raw_path = NULL;
+    long raw_size, len, ref_len, dtx_len;
+    short *pcm;
+    unsigned char *ref, *ref_dtx, *out;
+    openlpc_encoder_state *enc;
+    unsigned long long t0, frame_ns = ~0ull;
+    double mean_ns, worst_ns;
+    int frames, size, failed = 0;
+    int i, b, it;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            framelen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc && nblocks < MAX_BLOCKS)
+            blocks[nblocks++] = atoi(argv[++i]);
+        else if (raw_path == NULL)
+            raw_path = argv[i];
+        else
+            break;
+    }
+    if (nblocks == 0)
+        nblocks = 5;
+    for (b = 0; b < nblocks; b++)
+        if (blocks[b] < 1)
+            break;
+    if (raw_path == NULL || i < argc || b < nblocks || framelen < 2 || iterations < 1)
+    {
+        fprintf(stderr, "usage: %s [-f framelen] [-n iterations] [-b block]... file.raw\n", argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(raw_path, &raw_size);
+    frames = raw_size / 2 / framelen;
+    size = OPENLPC_ENCODED_FRAME_SIZE;
+    ref = (unsigned char *)malloc((size_t)frames * size);
+    ref_dtx = (unsigned char *)malloc((size_t)frames * size);
+    out = (unsigned char *)malloc((size_t)(frames + 1) * size);
+    enc = create_openlpc_encoder_state();
+
+    /* the frame by frame references, and the time of a whole frame */
+    for (it = 0; it < iterations; it++)
+    {
+        init_openlpc_encoder_state(enc, framelen);
+        for (i = 0; i < frames; i++)
+        {
+            t0 = now_ns();
+            openlpc_encode(pcm + i * framelen, ref + i * size, enc);
+            t0 = now_ns() - t0;
+            if (t0 < frame_ns)
+                frame_ns = t0;
+        }
+    }
+    ref_len = (long)frames * size;
+    init_openlpc_encoder_state(enc, framelen);
+    for (i = 0, dtx_len = 0; i < frames; i++)
+        dtx_len += openlpc_encode_dtx(pcm + i * framelen, ref_dtx + dtx_len, enc);
+
+    printf("%s: %d frames of %d samples, openlpc_encode %.0f ns/frame at best\n",
+        raw_path, frames, framelen, (double)frame_ns);
+
+    for (b = 0; b < nblocks; b++)
+    {
+        int ok, ok_dtx;
+
+        len = push_all(pcm, (long)frames * framelen, blocks[b], 0, framelen, iterations, out, enc,
+            &mean_ns, &worst_ns);
+        ok = len == ref_len && memcmp(out, ref, ref_len) == 0;
+        printf("block %4d: %8.0f ns/call mean %8.0f ns worst  %s", blocks[b], mean_ns, worst_ns,
+            ok ? "bit exact" : "DIFFERS");
+
+        len = push_all(pcm, (long)frames * framelen, blocks[b], 1, framelen, 1, out, enc,
+            &mean_ns, &worst_ns);
+        ok_dtx = len == dtx_len && memcmp(out, ref_dtx, dtx_len) == 0;
+        printf(", dtx %s\n", ok_dtx ? "bit exact" : "DIFFERS");
+        failed |= !ok || !ok_dtx;
+    }
+
+    destroy_openlpc_encoder_state(enc);
+    free(pcm);
+    free(ref);
+    free(ref_dtx);
+    free(out);
+    return failed;
+}
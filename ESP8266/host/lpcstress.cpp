@@ -0,0 +1,203 @@
+/*
+ * Multi-threaded stress test for the fixed point OpenLPC codec.
+ *
+ * Every thread owns 'streams' encoders and decoders and runs them
+ * interleaved frame by frame over the same input, so any state shared
+ * between instances shows up as output that differs from a single
+ * instance run. Reports the aggregate throughput for 1, 2, 4... threads
+ * and how it scales against one thread.
+ *
+ *   lpcstress [-t maxthreads] [-s streams] [-n iterations] hola.raw hola.lpc
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+#include <vector>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define FRAMELEN 160
+
+struct stress_input {
+    const short *pcm;
+    int enc_frames;
+    const unsigned char *lpc;
+    int dec_frames;
+    const unsigned char *ref_lpc;   /* single instance encoder output */
+    const short *ref_pcm;           /* single instance decoder output */
+};
+
+/* single instance reference run */
+static void reference(const short *pcm, int enc_frames, const unsigned char *lpc, int dec_frames,
+                      unsigned char *ref_lpc, short *ref_pcm)
+{
+    openlpc_encoder_state *enc = create_openlpc_encoder_state();
+    openlpc_decoder_state *dec = create_openlpc_decoder_state();
+    int i;
+
+    init_openlpc_encoder_state(enc, FRAMELEN);
+    for (i = 0; i < enc_frames; i++)
+        openlpc_encode(pcm + i * FRAMELEN, ref_lpc + i * OPENLPC_ENCODED_FRAME_SIZE, enc);
+
+    init_openlpc_decoder_state(dec, FRAMELEN);
+    for (i = 0; i < dec_frames; i++)
+        openlpc_decode(lpc + i * OPENLPC_ENCODED_FRAME_SIZE, ref_pcm + i * FRAMELEN, dec);
+
+    destroy_openlpc_encoder_state(enc);
+    destroy_openlpc_decoder_state(dec);
+}
+
+/* returns the number of frames that differ from the reference */
+static int worker(const stress_input *in, int streams, int iterations)
+{
+    std::vector<openlpc_encoder_state *> enc(streams);
+    std::vector<openlpc_decoder_state *> dec(streams);
+    int errors = 0;
+    int it, i, s;
+
+    for (s = 0; s < streams; s++)
+    {
+        enc[s] = create_openlpc_encoder_state();
+        dec[s] = create_openlpc_decoder_state();
+    }
+
+    for (it = 0; it < iterations; it++)
+    {
+        for (s = 0; s < streams; s++)
+        {
+            init_openlpc_encoder_state(enc[s], FRAMELEN);
+            init_openlpc_decoder_state(dec[s], FRAMELEN);
+        }
+
+        for (i = 0; i < in->enc_frames; i++)
+        {
+            for (s = 0; s < streams; s++)
+            {
+                unsigned char params[OPENLPC_ENCODED_FRAME_SIZE];
+
+                openlpc_encode(in->pcm + i * FRAMELEN, params, enc[s]);
+                if (memcmp(params, in->ref_lpc + i * OPENLPC_ENCODED_FRAME_SIZE, OPENLPC_ENCODED_FRAME_SIZE) != 0)
+                    errors++;
+            }
+        }
+
+        for (i = 0; i < in->dec_frames; i++)
+        {
+            for (s = 0; s < streams; s++)
+            {
+                short pcm[FRAMELEN];
+
+                /* all the threads decode straight from the shared input */
+                openlpc_decode(in->lpc + i * OPENLPC_ENCODED_FRAME_SIZE, pcm, dec[s]);
+                if (memcmp(pcm, in->ref_pcm + i * FRAMELEN, sizeof(pcm)) != 0)
+                    errors++;
+            }
+        }
+    }
+
+    for (s = 0; s < streams; s++)
+    {
+        destroy_openlpc_encoder_state(enc[s]);
+        destroy_openlpc_decoder_state(dec[s]);
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int maxthreads = (int)std::thread::hardware_concurrency();
+    int streams = 8;
+    int iterations = 4;
+    const char *raw_path = NULL, *lpc_path = NULL;
+    long raw_size, lpc_size;
+    stress_input in;
+    unsigned char *ref_lpc;
+    short *ref_pcm;
+    double base = 0;
+    int failed = 0;
+    int i, t;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            maxthreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            streams = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (raw_path == NULL)
+            raw_path = argv[i];
+        else if (lpc_path == NULL)
+            lpc_path = argv[i];
+        else
+            break;
+    }
+    if (maxthreads < 1)
+        maxthreads = 1;
+    if (raw_path == NULL || lpc_path == NULL || i < argc || streams < 1 || iterations < 1)
+    {
+        fprintf(stderr, "usage: %s [-t maxthreads] [-s streams] [-n iterations] file.raw file.lpc\n", argv[0]);
+        return 1;
+    }
+
+    in.pcm = (short *)load_file(raw_path, &raw_size);
+    in.lpc = load_file(lpc_path, &lpc_size);
+    in.enc_frames = raw_size / 2 / FRAMELEN;
+    in.dec_frames = lpc_size / OPENLPC_ENCODED_FRAME_SIZE;
+
+    ref_lpc = (unsigned char *)malloc(in.enc_frames * OPENLPC_ENCODED_FRAME_SIZE);
+    ref_pcm = (short *)malloc(in.dec_frames * FRAMELEN * sizeof(short));
+    reference(in.pcm, in.enc_frames, in.lpc, in.dec_frames, ref_lpc, ref_pcm);
+    in.ref_lpc = ref_lpc;
+    in.ref_pcm = ref_pcm;
+
+    printf("%d streams per thread, %d iterations, %d+%d frames per stream\n",
+        streams, iterations, in.enc_frames, in.dec_frames);
+
+    for (t = 1; t <= maxthreads; t *= 2)
+    {
+        std::vector<std::thread> threads;
+        std::vector<int> errors(t);
+        unsigned long long t0, t1;
+        double frames_per_s;
+        int total_errors = 0;
+
+        t0 = now_ns();
+        for (i = 0; i < t; i++)
+            threads.push_back(std::thread([&in, &errors, i, streams, iterations]() {
+                errors[i] = worker(&in, streams, iterations);
+            }));
+        for (i = 0; i < t; i++)
+            threads[i].join();
+        t1 = now_ns();
+
+        for (i = 0; i < t; i++)
+            total_errors += errors[i];
+
+        frames_per_s = (double)t * streams * iterations * (in.enc_frames + in.dec_frames) * 1e9 / (t1 - t0);
+        if (t == 1)
+            base = frames_per_s;
+
+        printf("%3d threads %5d streams %12.0f frames/s %6.2fx scaling %s\n",
+            t, t * streams, frames_per_s, frames_per_s / base,
+            total_errors == 0 ? "bit-exact" : "MISMATCH");
+        if (total_errors != 0)
+        {
+            printf("    %d frames differ from the single instance run\n", total_errors);
+            failed = 1;
+        }
+
+        if (t < maxthreads && t * 2 > maxthreads)
+            t = maxthreads / 2;
+    }
+
+    free((void *)in.pcm);
+    free((void *)in.lpc);
+    free(ref_lpc);
+    free(ref_pcm);
+    return failed;
+}
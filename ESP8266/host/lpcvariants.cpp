@@ -0,0 +1,188 @@
+/*
+ * Benchmark of the codec variants (frame length and bits per frame).
+ *
+ * Encodes a raw 8 kHz 16-bit mono file with each variant, and with the
+ * low delay encoder (init_openlpc_encoder_state_low_delay), decodes the
+ * result back, and reports the bitrate and ns/frame of the fastest of
+ * 'iterations' passes for both. With -o, the encoded and decoded streams
+ * are written to <prefix>_<framelen>_<bits>.lpc and .raw, so a build with
+ * -DOPENLPC_GENERIC_ONLY can be checked against the specialized one.
+ *
+ * The OPENLPC_EXACT_FILTERS and OPENLPC_LINEAR_Q variants are checked
+ * against the one with the same frame length and bits without them: the
+ * stream must change, but not much, with the voicing and the pitch of
+ * most frames the same and the decoded energy within OPT_MAX_DB.
+ *
+ *   lpcvariants [-n iterations] [-o prefix] hola.raw
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "hostutil.h"
+#include "openlpc.h"
+
+#define OPT_MIN_SAME    0.9     /* frames with the period and voicing of the plain variant */
+#define OPT_MAX_DB      1.0
+
+#define OPT_MASK        (OPENLPC_EXACT_FILTERS | OPENLPC_LINEAR_Q)
+
+typedef struct lpc_variant {
+    int framelen, lpcbits, low_delay;
+} lpc_variant;
+
+static const lpc_variant variants[] = {
+    { 160, OPENLPC_BITS_38 },                     /* specialized */
+    { OPENLPC_FRAMESIZE_1_4, OPENLPC_BITS_32 },   /* specialized */
+    { OPENLPC_FRAMESIZE_1_8, OPENLPC_BITS_38 },
+    { OPENLPC_FRAMESIZE_1_4, OPENLPC_BITS_38 },
+    { 160, OPENLPC_BITS_32 },
+    { 160, OPENLPC_BITS_80 },
+    { 160, OPENLPC_BITS_38 | OPENLPC_EXACT_FILTERS },
+    { 160, OPENLPC_BITS_38 | OPENLPC_LINEAR_Q },
+    { 160, OPENLPC_BITS_38 | OPENLPC_EXACT_FILTERS | OPENLPC_LINEAR_Q },
+    { 160, OPENLPC_BITS_32 | OPENLPC_EXACT_FILTERS | OPENLPC_LINEAR_Q },
+    { OPENLPC_FRAMESIZE_LOW_DELAY, OPENLPC_BITS_38, 1 },
+};
+
+static double energy_db(const short *x, long n)
+{
+    double e = 1;
+    long i;
+
+    for (i = 0; i < n; i++)
+        e += (double)x[i] * x[i];
+    return 10 * log10(e);
+}
+
+/* checks variant v, with options, against the plain one p; returns 1 if
+   the options change nothing or too much */
+static int check_options(int v, int p, unsigned char **lpc, short **out, int frames)
+{
+    int size = openlpc_encoded_frame_size(variants[v].lpcbits);
+    long n = (long)frames * variants[v].framelen;
+    int f, same = 0, differ = 0;
+    double db = energy_db(out[v], n) - energy_db(out[p], n);
+
+    for (f = 0; f < frames; f++)
+    {
+        const unsigned char *a = lpc[v] + f * size, *b = lpc[p] + f * size;
+
+        if (a[0] == b[0] && (a[1] & 3) == (b[1] & 3))
+            same++;
+        if (memcmp(a, b, size) != 0)
+            differ++;
+    }
+    printf("    against no options: %5.1f%% of the frames differ, %5.1f%% same period and voicing, energy %+5.2f dB\n",
+        100.0 * differ / frames, 100.0 * same / frames, db);
+    if (differ == 0 || same < OPT_MIN_SAME * frames || fabs(db) > OPT_MAX_DB)
+    {
+        printf("    options not applied, or off\n");
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = 20;
+    const char *raw_path = NULL, *prefix = NULL;
+    long raw_size;
+    short *pcm;
+    unsigned char *lpcs[sizeof(variants) / sizeof(variants[0])];
+    short *outs[sizeof(variants) / sizeof(variants[0])];
+    int v, p, i, failed = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            prefix = argv[++i];
+        else if (raw_path == NULL)
+            raw_path = argv[i];
+        else
+            break;
+    }
+    if (raw_path == NULL || i < argc || iterations < 1)
+    {
+        fprintf(stderr, "usage: %s [-n iterations] [-o prefix] file.raw\n", argv[0]);
+        return 1;
+    }
+
+    pcm = (short *)load_file(raw_path, &raw_size);
+    printf("%s: %ld samples, %d iterations\n", raw_path, raw_size / 2, iterations);
+
+    for (v = 0; v < (int)(sizeof(variants) / sizeof(variants[0])); v++)
+    {
+        int framelen = variants[v].framelen, lpcbits = variants[v].lpcbits;
+        int size = openlpc_encoded_frame_size(lpcbits);
+        int frames = raw_size / 2 / framelen;
+        unsigned char *lpc = (unsigned char *)malloc(frames * size);
+        short *out = (short *)malloc(frames * framelen * sizeof(short));
+        openlpc_encoder_state *enc = create_openlpc_encoder_state();
+        openlpc_decoder_state *dec = create_openlpc_decoder_state();
+        unsigned long long t0, enc_ns = ~0ull, dec_ns = ~0ull;
+        int it;
+
+        for (it = 0; it < iterations; it++)
+        {
+            t0 = now_ns();
+            if (variants[v].low_delay)
+                init_openlpc_encoder_state_low_delay(enc, framelen, lpcbits);
+            else
+                init_openlpc_encoder_state_bits(enc, framelen, lpcbits);
+            openlpc_encode_frames(pcm, frames, lpc, enc);
+            t0 = now_ns() - t0;
+            if (t0 < enc_ns)
+                enc_ns = t0;
+
+            t0 = now_ns();
+            init_openlpc_decoder_state_bits(dec, framelen, lpcbits);
+            openlpc_decode_frames(lpc, frames, out, dec);
+            t0 = now_ns() - t0;
+            if (t0 < dec_ns)
+                dec_ns = t0;
+        }
+
+        printf("framelen %3d, %2d bits: %2d bytes %5.0f bps  encode %6.0f ns/frame  decode %6.0f ns/frame%s%s%s\n",
+            framelen, lpcbits & ~OPT_MASK, size, 8000.0 * size * 8 / framelen,
+            (double)enc_ns / frames, (double)dec_ns / frames, variants[v].low_delay ? "  low delay" : "",
+            lpcbits & OPENLPC_EXACT_FILTERS ? "  exact filters" : "", lpcbits & OPENLPC_LINEAR_Q ? "  linear k1 k2" : "");
+        lpcs[v] = lpc;
+        outs[v] = out;
+
+        for (p = 0; p < v && (lpcbits & OPT_MASK); p++)
+        {
+            if (variants[p].framelen == framelen && variants[p].lpcbits == (lpcbits & ~OPT_MASK) && !variants[p].low_delay)
+            {
+                failed |= check_options(v, p, lpcs, outs, frames);
+                break;
+            }
+        }
+
+        if (prefix != NULL)
+        {
+            char path[256];
+
+            snprintf(path, sizeof(path), "%s_%d_%d.lpc", prefix, framelen, lpcbits);
+            write_file(path, lpc, frames * size);
+            snprintf(path, sizeof(path), "%s_%d_%d.raw", prefix, framelen, lpcbits);
+            write_file(path, out, frames * framelen * sizeof(short));
+        }
+
+        destroy_openlpc_encoder_state(enc);
+        destroy_openlpc_decoder_state(dec);
+    }
+
+    for (v = 0; v < (int)(sizeof(variants) / sizeof(variants[0])); v++)
+    {
+        free(lpcs[v]);
+        free(outs[v]);
+    }
+    free(pcm);
+    return failed;
+}
@@ -0,0 +1,18 @@
+/*
+ * Builds the floating point reference codec with prefixed entry points.
+ * openlpc.h is included first, unprefixed: the reference openlpc_decode()
+ * takes a non-const buffer, which it shifts in place.
+ */
+
+#include "openlpc.h"
+
+#define create_openlpc_encoder_state    flt_create_openlpc_encoder_state
+#define init_openlpc_encoder_state      flt_init_openlpc_encoder_state
+#define openlpc_encode                  flt_openlpc_encode
+#define destroy_openlpc_encoder_state   flt_destroy_openlpc_encoder_state
+#define create_openlpc_decoder_state    flt_create_openlpc_decoder_state
+#define init_openlpc_decoder_state      flt_init_openlpc_decoder_state
+#define openlpc_decode                  flt_openlpc_decode
+#define destroy_openlpc_decoder_state   flt_destroy_openlpc_decoder_state
+
+#include "openlpc.c.org"
@@ -0,0 +1,29 @@
+/*
+ * Floating point reference codec (src/openlpc.c.org), built for the host
+ * with an flt_ prefix so it can be linked next to the fixed point one.
+ */
+
+#ifndef OPENLPC_FLOAT_H
+#define OPENLPC_FLOAT_H
+
+#include "openlpc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+openlpc_encoder_state *flt_create_openlpc_encoder_state(void);
+void flt_init_openlpc_encoder_state(openlpc_encoder_state *st, int framelen);
+int  flt_openlpc_encode(const short *in, unsigned char *out, openlpc_encoder_state *st);
+void flt_destroy_openlpc_encoder_state(openlpc_encoder_state *st);
+
+openlpc_decoder_state *flt_create_openlpc_decoder_state(void);
+void flt_init_openlpc_decoder_state(openlpc_decoder_state *st, int framelen);
+int  flt_openlpc_decode(unsigned char *in, short *out, openlpc_decoder_state *st);
+void flt_destroy_openlpc_decoder_state(openlpc_decoder_state *st);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* OPENLPC_FLOAT_H */
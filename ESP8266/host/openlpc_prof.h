@@ -0,0 +1,36 @@
+/*
+ * Per-stage timing for the fixed point codec (host builds only).
+ *
+ * openlpc_fixed.cpp includes this file when OPENLPC_PROFILE is defined;
+ * PROF_MARK() charges the time elapsed since the previous mark to a stage.
+ */
+
+#ifndef OPENLPC_PROF_H
+#define OPENLPC_PROF_H
+
+enum openlpc_prof_stage {
+    PROF_PREFILTER,     /* anti-hum high-pass, pitch low-pass and preemphasis */
+    PROF_WINDOW,        /* Hamming windowing (ANALYSIS_MULTIPASS) */
+    PROF_AUTOCORR,      /* auto_correl2, or windowing too (ANALYSIS_FUSED) */
+    PROF_DURBIN,        /* durbin */
+    PROF_PITCH_CORREL,  /* decimation and autocorrelation of both pitch regions */
+    PROF_PITCH_PICK,    /* pitch peak search and voicing of both regions */
+    PROF_QUANT,         /* parameter quantization and packing */
+    PROF_UNPACK,        /* decoder parameter unpacking */
+    PROF_SYNTH,         /* decoder excitation and lattice synthesis */
+    PROF_COUNT
+};
+
+extern const char *openlpc_prof_name[PROF_COUNT];
+extern unsigned long long openlpc_prof_ns[PROF_COUNT];
+
+unsigned long long openlpc_prof_now(void);
+
+#define PROF_BEGIN()    unsigned long long prof_t0 = openlpc_prof_now()
+#define PROF_MARK(stage) do { \
+        unsigned long long prof_t1 = openlpc_prof_now(); \
+        openlpc_prof_ns[stage] += prof_t1 - prof_t0; \
+        prof_t0 = prof_t1; \
+    } while(0)
+
+#endif /* OPENLPC_PROF_H */
@@ -0,0 +1,192 @@
+/*
+ * Capture ring test.
+ *
+ * A thread stands in for the 8 kHz sample timer interrupt and put()s into
+ * the AudioRing that AudioIn.cpp uses, while the main thread takes frames
+ * out like loop() does:
+ *
+ *   paced   samples at 8 kHz, a consumer polling every millisecond: no
+ *           frame may be dropped; reports the time from the last sample
+ *           of a frame to lock() returning it
+ *   slow    samples at 8 kHz, a consumer taking 30 ms per 20 ms frame:
+ *           frames must be dropped whole, and counted
+ *   burst   both sides flat out, yielding after each frame or empty
+ *           poll, to shake out ordering problems
+ *
+ * Every sample carries its frame number and its index in the frame; each
+ * frame taken out must be whole and the next one the producer did not
+ * drop, the overruns must count the frames dropped and the captured
+ * frames the others; the high-water mark must reach the ring depth only
+ * when frames are dropped.
+ *
+ *   ringtest [-s seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <thread>
+
+#include "hostutil.h"
+#include "AudioIn.h"
+#include "AudioRing.h"
+
+#define RATE        8000
+#define MAX_FRAMES  20000
+
+typedef AudioRing<AUDIO_IN_FRAMES, AUDIO_IN_FRAMESIZE> Ring;
+
+static void sleep_until(unsigned long long t)
+{
+    struct timespec ts;
+
+    ts.tv_sec = t / 1000000000ull;
+    ts.tv_nsec = t % 1000000000ull;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+static Ring ring;
+static unsigned long long frame_done[MAX_FRAMES];   /* time of the last sample of each frame */
+static char frame_dropped[MAX_FRAMES];              /* put() dropped the frame */
+static volatile int producer_done;
+
+/* the sample timer: frames of (frame number << 8) | index, at 'rate'
+   samples a second, or flat out if rate is 0. Whether a frame is dropped
+   is known at its first sample, before it could be published. */
+static void producer(long frames, int rate)
+{
+    unsigned long long t = now_ns();
+    long f;
+    int i;
+
+    for (f = 0; f < frames; f++)
+    {
+        for (i = 0; i < AUDIO_IN_FRAMESIZE; i++)
+        {
+            if (rate)
+            {
+                t += 1000000000ull / rate;
+                sleep_until(t);
+            }
+            if (i == AUDIO_IN_FRAMESIZE - 1)
+                __atomic_store_n(&frame_done[f], now_ns(), __ATOMIC_RELAXED);
+            if (!ring.put((short)(((f & 0xff) << 8) | i)) && i == 0)
+                __atomic_store_n(&frame_dropped[f], 1, __ATOMIC_RELAXED);
+        }
+        if (!rate)
+            std::this_thread::yield();  /* let a consumer on the same core in */
+    }
+    __atomic_store_n(&producer_done, 1, __ATOMIC_RELEASE);
+}
+
+/* runs one scenario; expect_drops is 1 if frames must be dropped, 0 if
+   none may be, -1 if either will do. Returns 1 if it failed. */
+static int run(const char *name, long frames, int rate, unsigned long long poll_ns, unsigned long long work_ns,
+               int expect_drops)
+{
+    unsigned long long latency = 0, worst = 0;
+    long taken = 0, missing = 0, expected = 0;
+    int failed = 0, i;
+
+    ring.reset();
+    producer_done = 0;
+    memset(frame_done, 0, sizeof(frame_done));
+    memset(frame_dropped, 0, sizeof(frame_dropped));
+    std::thread isr(producer, frames, rate);
+
+    for (;;)
+    {
+        int done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+        short *data = ring.lock();
+
+        if (data == NULL)
+        {
+            if (done)
+                break;
+            if (poll_ns)
+                sleep_until(now_ns() + poll_ns);
+            else
+                std::this_thread::yield();
+            continue;
+        }
+
+        /* the next frame that was not dropped, whole */
+        while (expected < frames && __atomic_load_n(&frame_dropped[expected], __ATOMIC_RELAXED))
+        {
+            expected++;
+            missing++;
+        }
+        for (i = 0; i < AUDIO_IN_FRAMESIZE; i++)
+            if (data[i] != (short)(((expected & 0xff) << 8) | i))
+                break;
+        if (i < AUDIO_IN_FRAMESIZE)
+        {
+            printf("%s: frame %ld wrong at sample %d\n", name, expected, i);
+            failed = 1;
+        }
+        if (rate)
+        {
+            unsigned long long t = now_ns() - __atomic_load_n(&frame_done[expected], __ATOMIC_RELAXED);
+
+            latency += t;
+            if (t > worst)
+                worst = t;
+        }
+        expected++;
+        taken++;
+
+        if (work_ns)
+            sleep_until(now_ns() + work_ns);
+        ring.unlock();
+    }
+    isr.join();
+
+    printf("%-6s %6ld frames: %6ld taken %6ld dropped (%u overruns)  high water %u",
+        name, frames, taken, frames - taken, ring.overrunCount(), ring.highWaterMark());
+    if (rate && taken)
+        printf("  latency %.2f ms mean %.2f ms worst", latency / 1e6 / taken, worst / 1e6);
+    printf("\n");
+
+    /* the frames missing are the ones dropped, and they were counted */
+    if (taken + (long)ring.overrunCount() != frames || missing + (frames - expected) != (long)ring.overrunCount())
+    {
+        printf("%s: %ld frames taken and %u overruns don't add up to %ld\n", name, taken, ring.overrunCount(), frames);
+        failed = 1;
+    }
+    if (ring.capturedCount() != (unsigned)taken || ring.highWaterMark() < 1 || ring.highWaterMark() > AUDIO_IN_FRAMES
+        || (ring.overrunCount() != 0 && ring.highWaterMark() != AUDIO_IN_FRAMES))
+    {
+        printf("%s: %u frames captured, high water %u\n", name, ring.capturedCount(), ring.highWaterMark());
+        failed = 1;
+    }
+    if ((expect_drops == 1 && ring.overrunCount() == 0) || (expect_drops == 0 && ring.overrunCount() != 0))
+    {
+        printf("%s: %s\n", name, expect_drops ? "no frame dropped" : "frames dropped");
+        failed = 1;
+    }
+    return failed;
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = 2, failed = 0;
+    long frames;
+
+    if (argc == 3 && strcmp(argv[1], "-s") == 0)
+        seconds = atoi(argv[2]);
+    else if (argc != 1)
+        seconds = 0;
+    if (seconds < 1 || seconds > MAX_FRAMES / (RATE / AUDIO_IN_FRAMESIZE))
+    {
+        fprintf(stderr, "usage: %s [-s seconds]\n", argv[0]);
+        return 1;
+    }
+    frames = (long)seconds * RATE / AUDIO_IN_FRAMESIZE;
+
+    printf("%d frames of %d samples\n", AUDIO_IN_FRAMES, AUDIO_IN_FRAMESIZE);
+    failed |= run("paced", frames, RATE, 1000000, 0, 0);
+    failed |= run("slow", frames, RATE, 1000000, 30000000, 1);
+    failed |= run("burst", MAX_FRAMES, 0, 0, 0, -1);
+    return failed;
+}
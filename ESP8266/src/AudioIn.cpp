@@ -2,72 +2,23 @@
 #include <Arduino.h>
 #include "AudioIn.h"
 
-static short buffer[4][AUDIO_IN_FRAMESIZE];
-volatile static int bufPos = 0;
-volatile static int bufLen = 0;
+#include "AudioRing.h"
+#include "SampleClock.h"
 
-volatile static int state = 1;
+// timer1 at TIM_DIV1 counts the 80 MHz APB clock, whatever the CPU clock
+#define AUDIO_IN_TIMER_HZ 80000000
 
-static short * ICACHE_RAM_ATTR GetNewBuffer()
-{
-  if (bufLen<4)
-  {
-    if (state == 1)
-    {
-      Serial.print('S'); //signal no more dropped buffers
-      state = 0;
-    }
-
-    return buffer[(bufPos + (bufLen++))&0x3];
-  }
-
-  if (state == 0)
-  {
-    Serial.print('d'); //signal dropped buffer
-    state = 1;
-  }
-
-  return NULL;
-}
-
-static short *Lock()
-{
-  if (bufLen>1)
-    return buffer[bufPos];
-  else
-    return NULL;
-}
-
-static void Unlock()
-{
-    noInterrupts();
-    bufPos = (bufPos+1) & 0x3;
-    bufLen--;
-    interrupts();
-}
+static AudioRing<AUDIO_IN_FRAMES, AUDIO_IN_FRAMESIZE> ring;
 
-short *currBuffer = NULL;
-volatile static int dataPos = 0;
+// sample interrupt timing; the counters are written by the ISR only
+static uint32_t isrPeriod = 0;      // cycles between two ticks
+static uint32_t isrLastTick = 0;
+static uint32_t isrLate = 0;        // ticks more than half a period late
+static uint32_t isrMaxCycles = 0;   // longest ISR
 
-void Put(short value)
+void ICACHE_RAM_ATTR Put(short value)
 {
-    if (currBuffer==NULL)
-    {
-        currBuffer = GetNewBuffer();
-        if (currBuffer==NULL)
-        {
-            return;
-        }
-    }
-
-    currBuffer[dataPos++] = value;
-
-	// If the buffer is full, signal it's ready to be sent and switch to the other one
-    if (dataPos >= AUDIO_IN_FRAMESIZE)
-    {
-        dataPos = 0;
-        currBuffer = GetNewBuffer();
-    }
+  ring.put(value);
 }
 
 void BufferDebug()
@@ -76,53 +27,105 @@ void BufferDebug()
 
   for(;;)
   {
-    short *data = Lock();
+    short *data = ring.lock();
     if (data==NULL)
       break;
-    Serial.printf("chunk: %p, %i %i\n", data, bufPos, bufLen);
+    Serial.printf("chunk: %p, %u\n", data, ring.available());
 
-    for(int i=0;i<160;i++)
+    for(int i=0;i<AUDIO_IN_FRAMESIZE;i++)
     {
       Serial.printf("%i ", data[i]);
     }
     Serial.printf("\n");
     ESP.wdtFeed();
-    Unlock();
+    ring.unlock();
   }
-  Serial.printf("bufptr: %i\n", dataPos);
+  Serial.printf("overruns: %u\n", ring.overrunCount());
 }
 
 short *aiLock()
 {
-    return Lock();
+  return ring.lock();
 }
 
 void aiUnlock()
 {
-  Unlock();
+  ring.unlock();
+}
+
+unsigned aiOverruns()
+{
+  return ring.overrunCount();
 }
 
 static GetSampleFn ReadMic=NULL;
+static unsigned int captureRate = 0;
+
+// timer1 for SampleClock: T1V counts down to the next interrupt, writing
+// T1L restarts it from there
+struct Timer1
+{
+  inline __attribute__((always_inline)) uint32_t count() { return T1V; }
+  inline __attribute__((always_inline)) void load(uint32_t ticks) { T1L = ticks & 0x7FFFFF; }
+};
+
+static SampleClock sampleClock;
 
 void ICACHE_RAM_ATTR sample_isr()
 {
+  uint32_t t0 = ESP.getCycleCount();
+  uint32_t cycles;
+
+  // no UART work here: a late tick or a dropped frame only bumps a
+  // counter, loop() reports them
+  if (isrLastTick != 0 && t0 - isrLastTick > isrPeriod + isrPeriod/2)
+    __atomic_store_n(&isrLate, isrLate + 1, __ATOMIC_RELAXED);
+  isrLastTick = t0;
+
+  // first, so the ticks taken to get here are known as well as possible
+  Timer1 timer;
+  sampleClock.tick(timer);
+
   Put(ReadMic());
+
+  cycles = ESP.getCycleCount() - t0;
+  if (cycles > isrMaxCycles)
+    __atomic_store_n(&isrMaxCycles, cycles, __ATOMIC_RELAXED);
+}
+
+void aiStats(AudioInStats *st)
+{
+  st->captured = ring.capturedCount();
+  st->dropped = ring.overrunCount();
+  st->highWater = ring.highWaterMark();
+  st->isrLate = __atomic_load_n(&isrLate, __ATOMIC_RELAXED);
+  st->isrMaxCycles = __atomic_load_n(&isrMaxCycles, __ATOMIC_RELAXED);
+}
+
+unsigned int aiRate()
+{
+  return captureRate;
 }
 
 void aiBegin(GetSampleFn pfn, unsigned int sampleRate)
 {
   ReadMic = pfn;
+  captureRate = sampleRate;
 
   Serial.printf("timer - begin\n");
-  dataPos = 0;
+  ring.reset();
+  isrLastTick = 0;
+  isrLate = 0;
+  isrMaxCycles = 0;
 
   timer1_isr_init();
   timer1_attachInterrupt(sample_isr);
 
-  // 80Mhz/16 * 5
-
-  int period = 125;//(1000000/8000);
-  timer1_write(clockCyclesPerMicrosecond() * period);//* sampleRate); //125us = 8kHz sampling freq
+  // any rate: the periods are whole timer ticks, SampleClock makes them
+  // add up to the rate
+  sampleClock.begin(AUDIO_IN_TIMER_HZ, sampleRate);
+  isrPeriod = clockCyclesPerMicrosecond() * 1000000 / sampleRate;
+  timer1_write(sampleClock.first());
   timer1_enable(TIM_DIV1, TIM_EDGE, TIM_LOOP);
 }
 
@@ -130,4 +133,5 @@ void aiEnd()
 {
   timer1_disable();
   ReadMic=NULL;
+  captureRate = 0;
 }
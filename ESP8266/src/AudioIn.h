@@ -1,7 +1,33 @@
+#include <stdint.h>
+
 typedef short (*GetSampleFn)();
 
+// aiLock() returns the oldest full frame as soon as it is complete, or
+// NULL; aiUnlock() gives it back. aiOverruns() counts the frames dropped
+// because the ring was full.
 short *aiLock();
 void aiUnlock();
+unsigned aiOverruns();
+// Starts sampling pfn at sampleRate, any rate from 10 Hz: the timer
+// periods are whole ticks of 12.5 ns, spread so they don't drift from the
+// rate. aiRate() is the rate, or 0 when stopped.
 void aiBegin(GetSampleFn pfn, unsigned int sampleRate);
 void aiEnd();
+unsigned int aiRate();
 #define AUDIO_IN_FRAMESIZE 160
+#define AUDIO_IN_WIDEBAND  16000  // rate of the wideband capture, decimated to 8 kHz for the codec
+#define AUDIO_IN_FRAMES    4    // capture ring depth, a power of two
+
+// Capture telemetry since aiBegin(). The sample interrupt only bumps these
+// counters, it never prints; aiStats() copies them without masking it, so
+// a snapshot can be a sample apart between fields.
+struct AudioInStats
+{
+  uint32_t captured;      // frames handed to aiLock()
+  uint32_t dropped;       // frames dropped, the ring was full
+  uint32_t highWater;     // most full frames waiting at once, up to AUDIO_IN_FRAMES
+  uint32_t isrLate;       // sample ticks more than half a period late
+  uint32_t isrMaxCycles;  // longest sample interrupt, in CPU cycles
+};
+
+void aiStats(AudioInStats *st);
@@ -14,10 +14,17 @@
 #include "AudioIn.h"
 #include "AudioOut.h"
 #include "adc3201.h"
+#include "Decimator.h"
+#include "Conditioner.h"
 
 #include <i2s.h>
 
+#define MIC_ADC_BACKEND ADC_BACKEND_GPIO   // the board has the converter on GPIO16/5/4
+#define MIC_BITS        12                 // offset binary codes from adcRead()
+#define MIC_AGC         true
+
 #define MY_OPENLPC_FRAMESIZE 160
+#define MY_OPENLPC_BATCH 4      // frames per openlpc_encode_frames/openlpc_decode_frames call
 
 
 #define OTA
@@ -32,34 +39,271 @@ AsyncEventSource events("/events");
 
 DNSServer dns;
 
-bool AudioIsRaw = true;
+// Link modes, from the best quality to the lowest bitrate. Every websocket
+// packet starts with the mode byte, followed by the 16 bit samples
+// (LINK_RAW) or by one encoded frame. The LPC modes don't send the frames
+// of silence (openlpc_encode_dtx), the browser plays comfort noise then.
+enum
+{
+  LINK_RAW,       // 160 samples, 128 kbit/s
+  LINK_LPC_160,   // 7 bytes per 160 samples, 2.8 kbit/s
+  LINK_LPC_250,   // 7 bytes per 250 samples, 1.8 kbit/s
+  LINK_LPC_320,   // 6 bytes per 320 samples, 1.2 kbit/s
+  LINK_MODES
+};
+
+// mode byte of LINK_RAW while capturing at AUDIO_IN_WIDEBAND: 160 samples
+// at 16 kHz, 256 kbit/s. The LPC modes get the capture decimated to 8 kHz.
+#define LINK_RAW_WIDE   LINK_MODES
+
+static const struct
+{
+  int framelen, lpcbits;
+} linkModes[LINK_MODES] =
+{
+  { AUDIO_IN_FRAMESIZE, 0 },
+  { MY_OPENLPC_FRAMESIZE, OPENLPC_BITS_38 },
+  { OPENLPC_FRAMESIZE_1_8, OPENLPC_BITS_38 },
+  { OPENLPC_FRAMESIZE_1_4, OPENLPC_BITS_32 },
+};
+
+#define LINK_QUEUE_HIGH 3     // step down when a client has this many messages queued
+#define LINK_UP_MS      2000  // step up after the queues have been empty this long
+#define LINK_PUSH_SLICE 32    // samples pushed to the encoder per loop() pass
+#define LINK_STATS_MS   1000  // capture stats sent to the websocket clients this often
+
+int linkTopMode = LINK_RAW;   // best mode allowed, set by /mode.html
+unsigned int linkCaptureRate = 8000;  // rate to capture at, AUDIO_IN_WIDEBAND after /mode.html?cmd=wide
+int linkMode = LINK_RAW;
+int linkEncoderMode = -1;     // mode encoder_st is set up for
+size_t linkStepDepth = LINK_QUEUE_HIGH-1;
+unsigned long linkDrainedSince = 0;
+unsigned long linkStatsSent = 0;
+
+// capture block being sent, from aiLock(), and how much of it is done;
+// in the LPC modes, of its 8 kHz samples: the block itself, or the block
+// decimated into linkNarrow when capturing at AUDIO_IN_WIDEBAND
+static short *linkBlock = NULL;
+int linkBlockPos = 0;
+static short *linkSamples = NULL;
+int linkSamplesLen = 0;
+static short linkNarrow[AUDIO_IN_FRAMESIZE/2];
+static Decimator2<AUDIO_IN_FRAMESIZE> linkDecimator;
+
+// conditions each capture block before it is sent or encoded: DC out,
+// scaled to 16 bit, AGC; and the cycles the last block took
+static InputConditioner linkConditioner;
+uint32_t linkCondCycles = 0;
 
 
 openlpc_encoder_state *encoder_st=NULL;
 openlpc_decoder_state *decoder_st=NULL;
 
+// as it comes, linkConditioner takes the offset out a block at a time
 short ReadMic()
 {
-  return adcRead();//-2048;
+  return adcRead();
 }
 
 int connectedClients = 0;
 
+// ids of the connected websocket clients, 0 for a free slot. A client
+// that finds no free slot is closed, so every client sent to is one whose
+// queue linkQueueDepth() looks at.
+#define LINK_MAX_CLIENTS 4
+uint32_t linkClients[LINK_MAX_CLIENTS];
+
+// replaces oldId with newId; false if oldId has no slot
+static bool linkTrackClient(uint32_t oldId, uint32_t newId)
+{
+  for (int i=0; i<LINK_MAX_CLIENTS; i++)
+  {
+    if (linkClients[i] == oldId)
+    {
+      linkClients[i] = newId;
+      return true;
+    }
+  }
+  return false;
+}
+
+// deepest outgoing queue among the connected clients
+static size_t linkQueueDepth()
+{
+  size_t depth = 0;
+
+  for (int i=0; i<LINK_MAX_CLIENTS; i++)
+  {
+    AsyncWebSocketClient *c = linkClients[i] ? ws.client(linkClients[i]) : NULL;
+    if (c != NULL && c->status() == WS_CONNECTED && c->queueLen() > depth)
+      depth = c->queueLen();
+  }
+  return depth;
+}
+
+// Steps one mode down while the queue keeps growing past LINK_QUEUE_HIGH,
+// and one mode up once every queue has stayed empty for LINK_UP_MS.
+static void linkAdapt()
+{
+  size_t depth = linkQueueDepth();
+  unsigned long now = millis();
+
+  if (depth > linkStepDepth)
+  {
+    if (linkMode < LINK_MODES-1)
+      linkMode++;
+    linkStepDepth = depth;
+  }
+  else if (depth < LINK_QUEUE_HIGH)
+  {
+    linkStepDepth = LINK_QUEUE_HIGH-1;
+  }
+
+  if (depth > 0)
+  {
+    linkDrainedSince = now;
+  }
+  else if (now - linkDrainedSince >= LINK_UP_MS && linkMode > linkTopMode)
+  {
+    linkMode--;
+    linkDrainedSince = now;
+  }
+
+  if (linkMode < linkTopMode)
+    linkMode = linkTopMode;
+}
+
+static void linkSetEncoder(int mode)
+{
+  if (linkEncoderMode != mode)
+  {
+    init_openlpc_encoder_state_bits(encoder_st, linkModes[mode].framelen, linkModes[mode].lpcbits);
+    linkEncoderMode = mode;
+  }
+}
+
+// Sends the capture block as it is in LINK_RAW. In the LPC modes pushes
+// LINK_PUSH_SLICE samples of it to the encoder per call, so the prefilters
+// run a bit at every loop() pass instead of all at once at the end of a
+// frame, and sends the frame a slice completes unless it is silence. The
+// mode only changes between capture blocks; a change drops the part of a
+// frame the encoder had.
+static void linkFeed()
+{
+  static unsigned char packet[1 + AUDIO_IN_FRAMESIZE*sizeof(short)];
+  int n, len;
+
+  if (linkBlock == NULL)
+  {
+    linkBlock = aiLock();
+    linkBlockPos = 0;
+    if (linkBlock == NULL)
+      return;
+    linkAdapt();
+
+    uint32_t t0 = ESP.getCycleCount();
+    linkConditioner.process(linkBlock, AUDIO_IN_FRAMESIZE);
+    linkCondCycles = ESP.getCycleCount() - t0;
+
+    // every wideband block goes through the decimator, so its history
+    // is right whenever the link steps down to LPC
+    if (aiRate() == AUDIO_IN_WIDEBAND)
+    {
+      linkSamplesLen = linkDecimator.process(linkBlock, AUDIO_IN_FRAMESIZE, linkNarrow);
+      linkSamples = linkNarrow;
+    }
+    else
+    {
+      linkSamplesLen = AUDIO_IN_FRAMESIZE;
+      linkSamples = linkBlock;
+    }
+  }
+
+  packet[0] = linkMode;
+  if (linkMode == LINK_RAW)
+  {
+    if (aiRate() == AUDIO_IN_WIDEBAND)
+      packet[0] = LINK_RAW_WIDE;
+    memcpy(&packet[1], linkBlock, AUDIO_IN_FRAMESIZE*sizeof(short));
+    ws.binaryAll((char*)packet, 1 + AUDIO_IN_FRAMESIZE*sizeof(short));
+    linkBlockPos = linkSamplesLen;
+  }
+  else
+  {
+    linkSetEncoder(linkMode);
+    n = linkSamplesLen - linkBlockPos;
+    if (n > LINK_PUSH_SLICE)
+      n = LINK_PUSH_SLICE;
+    // a slice is shorter than any frame, so it completes one at most
+    len = openlpc_encoder_push_dtx(&linkSamples[linkBlockPos], n, &packet[1], encoder_st);
+    linkBlockPos += n;
+    if (len > 0)
+      ws.binaryAll((char*)packet, 1 + len);
+  }
+
+  if (linkBlockPos >= linkSamplesLen)
+  {
+    aiUnlock();
+    linkBlock = NULL;
+  }
+}
+
+// Capture telemetry as JSON, for /stats and the websocket. Drops show up
+// here instead of on the serial port from inside the sample interrupt.
+static int linkStats(char *buf, size_t len)
+{
+  AudioInStats st;
+
+  aiStats(&st);
+  return snprintf(buf, len,
+    "{\"captured\":%u,\"dropped\":%u,\"highWater\":%u,"
+    "\"isrLate\":%u,\"isrMaxCycles\":%u,\"mode\":%i,\"rate\":%u,"
+    "\"condCycles\":%u,\"agcGain\":%i}",
+    (unsigned)st.captured, (unsigned)st.dropped, (unsigned)st.highWater,
+    (unsigned)st.isrLate, (unsigned)st.isrMaxCycles, linkMode, aiRate(),
+    (unsigned)linkCondCycles, linkConditioner.gain());
+}
+
+// Sends "stats {...}" as a text message every LINK_STATS_MS.
+static void linkPublishStats()
+{
+  char buf[224] = "stats ";
+  unsigned long now = millis();
+
+  if (now - linkStatsSent < LINK_STATS_MS)
+    return;
+  linkStatsSent = now;
+  linkStats(buf + 6, sizeof(buf) - 6);
+  ws.textAll(buf);
+}
+
 void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len)
 {
   if(type == WS_EVT_CONNECT)
   {
+    if (!linkTrackClient(0, client->id()))
+    {
+      client->close(1013, "too many clients");
+      return;
+    }
     client->ping();
     if (connectedClients==0)
     {
-        adcSetup();
-        //aiBegin(ReadMic,10);
+        adcSetup(MIC_ADC_BACKEND);
+        //aiBegin(ReadMic, linkCaptureRate);
+        linkDecimator.reset();
+        linkConditioner.begin(MIC_BITS, MIC_AGC);
         aoBegin(8000);
+        linkMode = linkTopMode;
+        linkEncoderMode = -1;
     }
     connectedClients++;
   }
   else if(type == WS_EVT_DISCONNECT)
   {
+    // a client refused at connect was never counted
+    if (!linkTrackClient(client->id(), 0))
+      return;
     connectedClients--;
     if (connectedClients==0)
     {
@@ -115,7 +359,7 @@ void setup()
   if (encoder_st!=NULL)
   {
       init_openlpc_encoder_state(encoder_st, MY_OPENLPC_FRAMESIZE);
-      Serial.println("OK");
+      Serial.printf("OK, %i bytes\n", openlpc_encoder_state_size(encoder_st));
   }
   else
   {
@@ -129,7 +373,7 @@ void setup()
   if (decoder_st!=NULL)
   {
       init_openlpc_decoder_state(decoder_st, MY_OPENLPC_FRAMESIZE);
-      Serial.println("OK");
+      Serial.printf("OK, %i bytes\n", openlpc_decoder_state_size(decoder_st));
   }
   else
   {
@@ -162,6 +406,14 @@ void setup()
     request->send(200, "text/plain", String(ESP.getFreeHeap()));
   });
 
+  server.on("/stats", HTTP_GET, [](AsyncWebServerRequest *request)
+  {
+    char buf[224];
+
+    linkStats(buf, sizeof(buf));
+    request->send(200, "application/json", buf);
+  });
+
   server.on("/mode.html", HTTP_GET, [](AsyncWebServerRequest *request)
   {
     if(request->hasParam("cmd"))
@@ -172,16 +424,25 @@ void setup()
         if (p->value()=="plc")
         {
           request->send(200, "text/plain", "openplc mode");
-          AudioIsRaw = false;
+          linkTopMode = LINK_LPC_160;
+          linkCaptureRate = 8000;
         }
         else if (p->value()=="raw")
         {
           request->send(200, "text/plain", "raw mode");
-          AudioIsRaw = true;
+          linkTopMode = LINK_RAW;
+          linkCaptureRate = 8000;
+        }
+        else if (p->value()=="wide")
+        {
+          // takes effect on the next capture start
+          request->send(200, "text/plain", "wideband raw mode");
+          linkTopMode = LINK_RAW;
+          linkCaptureRate = AUDIO_IN_WIDEBAND;
         }
         else
         {
-          request->send(200, "text/plain", "choose raw or plc");
+          request->send(200, "text/plain", "choose raw, wide or plc");
         }
       }
     }
@@ -222,22 +483,37 @@ void setup()
 
       unsigned char params[OPENLPC_ENCODED_FRAME_SIZE*400];
 
+      // an encoder of its own: encoder_st may be half way through a frame
+      // of the socket stream
+      openlpc_encoder_state *st = create_openlpc_encoder_state();
+      init_openlpc_encoder_state(st, MY_OPENLPC_FRAMESIZE);
+
       int i=0;
-      for(;;i+=OPENLPC_ENCODED_FRAME_SIZE)
+      int total=0;
+      uint64_t cycles=0;
+      for(;;)
       {
-        short data[MY_OPENLPC_FRAMESIZE];
-        int size = f.readBytes((char*)data, MY_OPENLPC_FRAMESIZE*2);
+        static short data[MY_OPENLPC_FRAMESIZE*MY_OPENLPC_BATCH];
+        int frames = f.readBytes((char*)data, sizeof(data)) / (MY_OPENLPC_FRAMESIZE*2);
         ESP.wdtFeed();
-        if (size<MY_OPENLPC_FRAMESIZE*2)
+        if (frames==0)
           break;
 
         Serial.printf("Encoded :%i \n",i);
 
-        openlpc_encode(data, &params[i], encoder_st);
+        // cycles of the encoder alone, to compare the analysis modes of
+        // openlpc_fixed.cpp on the device
+        uint32_t t0 = ESP.getCycleCount();
+        i += openlpc_encode_frames(data, frames, &params[i], st);
+        cycles += ESP.getCycleCount() - t0;
+        total += frames;
         ESP.wdtFeed();
       }
 
       f.close();
+      destroy_openlpc_encoder_state(st);
+      if (total > 0)
+        Serial.printf("%i frames, %u cycles/frame\n", total, (unsigned)(cycles / total));
       request->send_P(200, "application/octet-stream", params, i);
   });
 
@@ -251,25 +527,24 @@ void setup()
 
         request->send(request->beginChunkedResponse("application/octet-stream", [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t
         {
+            static short alignedbuffer[MY_OPENLPC_FRAMESIZE*MY_OPENLPC_BATCH];
+            unsigned char params[OPENLPC_ENCODED_FRAME_SIZE*MY_OPENLPC_BATCH];
             int frames = maxLen / (MY_OPENLPC_FRAMESIZE*2);
+            if (frames>MY_OPENLPC_BATCH)
+                frames = MY_OPENLPC_BATCH;
 
-            for(int i=0;i<frames;i++)
+            frames = f.readBytes((char*)params, frames*OPENLPC_ENCODED_FRAME_SIZE) / OPENLPC_ENCODED_FRAME_SIZE;
+            if (frames==0)
             {
-                unsigned char params[OPENLPC_ENCODED_FRAME_SIZE];
-                int size = f.readBytes((char*)params, OPENLPC_ENCODED_FRAME_SIZE);
-                if (size<7)
-                {
-                    f.close();
-                    return 0;
-                }
-
-                short alignedbuffer[MY_OPENLPC_FRAMESIZE];
-                openlpc_decode(params, alignedbuffer, decoder_st);
-                memcpy(&buffer[i*MY_OPENLPC_FRAMESIZE*2], alignedbuffer, MY_OPENLPC_FRAMESIZE*2);
-
-                ESP.wdtFeed();
+                f.close();
+                return 0;
             }
 
+            openlpc_decode_frames(params, frames, alignedbuffer, decoder_st);
+            memcpy(buffer, alignedbuffer, frames*MY_OPENLPC_FRAMESIZE*2);
+
+            ESP.wdtFeed();
+
             return frames * (MY_OPENLPC_FRAMESIZE*2);
         }));
     });
@@ -306,23 +581,9 @@ void loop()
 {
    if (connectedClients>0)
    {
-     short *data = aiLock();
-     if (data!=NULL)
-     {
-        if (AudioIsRaw==false)
-        {
-          unsigned char params[OPENLPC_ENCODED_FRAME_SIZE];
-          openlpc_encode(data, params, encoder_st);
-          ws.binaryAll((char*)params,OPENLPC_ENCODED_FRAME_SIZE);
-        }
-        else
-        {
-          ws.binaryAll((char*)data, MY_OPENLPC_FRAMESIZE);
-        }
-        aiUnlock();
-
-        ESP.wdtFeed();
-     }
+     linkFeed();
+     linkPublishStats();
+     ESP.wdtFeed();
    }
 
    MDNS.update();
@@ -153,21 +153,20 @@ void PlayHolaLPC(openlpc_decoder_state *st)
 {
     fs::File f = SPIFFS.open("/hola.lpc", "r");
 
-    unsigned char params[OPENLPC_ENCODED_FRAME_SIZE];
-    signed short data[160];
+    unsigned char params[OPENLPC_ENCODED_FRAME_SIZE*4];
+    static signed short data[160*4];
 
     aoBegin(8000);
 
     for(;;)
     {
-        //read coeffs
-        int size = f.readBytes((char*)params, OPENLPC_ENCODED_FRAME_SIZE);
-        if (size==0)
+        //read coeffs, a few frames at a time
+        int frames = f.readBytes((char*)params, sizeof(params)) / OPENLPC_ENCODED_FRAME_SIZE;
+        if (frames==0)
             break;
 
         //decode
-        openlpc_decode(params, data, st);
-        size = 160;
+        int size = openlpc_decode_frames(params, frames, data, st);
 
         int written = 0;
         while(written<size)
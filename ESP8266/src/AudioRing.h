@@ -0,0 +1,105 @@
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+// Single producer, single consumer ring of capture frames. The producer
+// (the sample timer interrupt) writes one sample at a time with put(); a
+// frame is handed over once it is full. The consumer (loop()) gets the
+// oldest full frame with lock() and gives it back with unlock().
+//
+// Each side only writes its own index and reads the other one with
+// acquire ordering, so nothing is ever masked: head is published with
+// release once the samples of a frame are written, tail once the consumer
+// is done reading one. The indexes run freely and wrap at 2^32, which is
+// why DEPTH has to be a power of two.
+//
+// A frame that finds the ring full is dropped whole and counted in
+// overruns. lock() finding the ring empty is not counted: loop() polls it
+// far more often than frames come, so that is the normal case. A frame
+// handed over late shows up in the sample interrupt timing instead. The
+// counters are 32 bit words written by the producer only, so the consumer
+// can read them at any time without a lock; they wrap.
+
+template <int DEPTH, int FRAMESIZE>
+class AudioRing
+{
+  static_assert(DEPTH >= 2 && (DEPTH & (DEPTH - 1)) == 0, "DEPTH must be a power of two");
+  static_assert(FRAMESIZE > 0, "FRAMESIZE must be positive");
+
+public:
+  AudioRing() { reset(); }
+
+  // not safe against put() or lock(): only while the producer is stopped
+  void reset()
+  {
+    head = tail = 0;
+    fill = 0;
+    dropping = false;
+    captured = overruns = 0;
+    highWater = 0;
+  }
+
+  // producer side; always inlined so that it runs from the caller's IRAM.
+  // Returns false if the sample was dropped.
+  inline __attribute__((always_inline)) bool put(short value)
+  {
+    if (fill == 0)
+    {
+      // a frame starts: is there a free slot for it?
+      dropping = head - __atomic_load_n(&tail, __ATOMIC_ACQUIRE) >= (unsigned)DEPTH;
+      if (dropping)
+        __atomic_store_n(&overruns, overruns + 1, __ATOMIC_RELAXED);
+    }
+    if (!dropping)
+      frames[head & (DEPTH - 1)][fill] = value;
+    if (++fill == FRAMESIZE)
+    {
+      fill = 0;
+      if (!dropping)
+      {
+        unsigned waiting = head + 1 - __atomic_load_n(&tail, __ATOMIC_RELAXED);
+
+        __atomic_store_n(&head, head + 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&captured, captured + 1, __ATOMIC_RELAXED);
+        if (waiting > highWater)
+          __atomic_store_n(&highWater, waiting, __ATOMIC_RELAXED);
+      }
+    }
+    return !dropping;
+  }
+
+  // consumer side: the oldest full frame, or NULL
+  short *lock()
+  {
+    if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) == tail)
+      return NULL;
+    return frames[tail & (DEPTH - 1)];
+  }
+
+  // gives the frame from lock() back to the producer
+  void unlock()
+  {
+    __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  // full frames waiting, as seen from either side
+  unsigned available() const
+  {
+    return __atomic_load_n(&head, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+  }
+
+  unsigned capturedCount() const { return __atomic_load_n(&captured, __ATOMIC_RELAXED); }
+  unsigned highWaterMark() const { return __atomic_load_n(&highWater, __ATOMIC_RELAXED); }
+  unsigned overrunCount() const { return __atomic_load_n(&overruns, __ATOMIC_RELAXED); }
+
+private:
+  short frames[DEPTH][FRAMESIZE];
+  unsigned head;      // frames written, producer only
+  unsigned tail;      // frames released, consumer only
+  int fill;           // samples in the frame being written, producer only
+  bool dropping;      // the frame being written is dropped, producer only
+  unsigned captured;  // frames handed over, producer only
+  unsigned highWater; // most full frames waiting, producer only
+  unsigned overruns;  // producer only
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CONDITIONER_H
+#define CONDITIONER_H
+
+#include <stdint.h>
+
+// Input conditioning of a capture block, run from loop() on each frame
+// aiLock() returns, never per sample in the interrupt. The converter gives
+// offset binary (0..4095 for the MCP3201); the codec wants signed 16 bit
+// audio with no DC, at a level its quantizers use well:
+//
+//   DC      a one-pole tracker of the offset, about 1 Hz at 8 kHz, kept in
+//           Q(30 - bits) so the fraction of the offset is removed too; the
+//           first block seeds it with its mean, so there is no second of
+//           offset decaying at the start
+//   scale   the input bits to full 16 bit, in the same shift
+//   AGC     one gain per block, from the block's peak, 1/4 to 64: down at
+//           once to keep the peak at COND_TARGET, up by 1/16 (0.5 dB) per
+//           block, 26 dB/s at 8 kHz, and held when the peak is under
+//           COND_FLOOR, so pauses and background noise are not pumped up.
+//           Going up, the gain ramps across the block, with no steps.
+//
+// Integer only: a multiply, an add and two shifts per sample and pass, one
+// division per block.
+
+#define COND_DC_SHIFT   10        // tracker time constant, 1024 samples
+#define COND_TARGET     16384     // peak the AGC aims at, -6 dBFS
+#define COND_FLOOR      64        // peaks under this, 4 codes of 12 bits, hold the gain
+#define COND_ONE        256       // unity gain, Q8
+#define COND_MIN_GAIN   (COND_ONE / 4)
+#define COND_MAX_GAIN   (COND_ONE * 64)
+
+class InputConditioner
+{
+public:
+  // bits of the input samples, offset binary or signed; agc off keeps unity gain
+  void begin(int bits, bool agc)
+  {
+    frac = 30 - bits;
+    this->agc = agc;
+    dc = 0;
+    primed = false;
+    g = COND_ONE;
+  }
+
+  // conditions n samples in place, n > 0
+  void process(short *x, int n)
+  {
+    int32_t peak = 0, target, g1, acc, step;
+    int i;
+
+    if (!primed)
+    {
+      int32_t sum = 0;
+
+      for (i = 0; i < n; i++)
+        sum += x[i];
+      dc = (sum / n) << frac;
+      primed = true;
+    }
+
+    // DC out and scaled to 16 bit, Q(30 - bits) down to Q(16 - bits)
+    for (i = 0; i < n; i++)
+    {
+      int32_t v = (int32_t)x[i] << frac;
+      int32_t y = (v - dc) >> 14;
+
+      dc += (v - dc) >> COND_DC_SHIFT;
+      y = y > 32767 ? 32767 : (y < -32768 ? -32768 : y);
+      x[i] = (short)y;
+      if (y < 0)
+        y = -y;
+      if (y > peak)
+        peak = y;
+    }
+
+    if (!agc)
+      return;
+
+    g1 = g;
+    if (peak >= COND_FLOOR)
+    {
+      target = (COND_TARGET * COND_ONE) / peak;
+      if (target < g)
+        g1 = target;
+      else
+      {
+        g1 = g + (g >> 4) + 1;
+        if (g1 > target)
+          g1 = target;
+      }
+      if (g1 < COND_MIN_GAIN)
+        g1 = COND_MIN_GAIN;
+      if (g1 > COND_MAX_GAIN)
+        g1 = COND_MAX_GAIN;
+    }
+
+    // from g to g1 over the block, the gain in Q16 for the ramp; a gain
+    // going down is g1 from the start, so the peak doesn't clip
+    if (g1 < g)
+      g = g1;
+    acc = g << 8;
+    step = ((g1 - g) << 8) / n;
+    for (i = 0; i < n; i++)
+    {
+      int32_t y;
+
+      acc += step;
+      y = (x[i] * (acc >> 8)) >> 8;
+      x[i] = (short)(y > 32767 ? 32767 : (y < -32768 ? -32768 : y));
+    }
+    g = g1;
+  }
+
+  // the gain at the end of the last block, Q8
+  int gain() const { return g; }
+
+private:
+  int32_t dc;       // input offset, Q(30 - bits)
+  int frac;
+  bool agc, primed;
+  int32_t g;        // Q8
+};
+
+#endif
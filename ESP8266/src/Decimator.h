@@ -0,0 +1,58 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <string.h>
+
+// 2:1 decimator, 16 kHz capture to the 8 kHz the codec runs at. The filter
+// is a 35 tap halfband FIR (Kaiser window, beta 6): flat to 3 kHz, -0.4 dB
+// at 3.4 kHz, 62 dB down from 5 kHz, so nothing above 5 kHz folds below
+// 3 kHz. In polyphase form only every other output is computed, and a
+// halfband filter has every other tap zero but the centre one: one output
+// takes the centre tap and 9 symmetric pairs.
+
+#define DECIM_TAPS   35
+#define DECIM_PAIRS  9
+#define DECIM_CENTER 16386
+
+// Q15 taps 0, 2, .. 16; tap 34 - i is tap i
+static const short decimTaps[DECIM_PAIRS] =
+{
+  9, -44, 120, -263, 509, -919, 1638, -3191, 10332
+};
+
+// MAXN is the most input samples per process() call.
+template <int MAXN>
+class Decimator2
+{
+public:
+  Decimator2() { reset(); }
+
+  void reset()
+  {
+    memset(x, 0, sizeof(x));
+  }
+
+  // decimates n input samples, n even and up to MAXN, into n / 2 output
+  // samples; returns n / 2
+  int process(const short *in, int n, short *out)
+  {
+    memcpy(x + DECIM_TAPS - 1, in, n * sizeof(short));
+    for (int m = 0; m < n / 2; m++)
+    {
+      const short *p = x + 2 * m;
+      int acc = DECIM_CENTER * p[DECIM_TAPS / 2] + (1 << 14);
+
+      for (int k = 0; k < DECIM_PAIRS; k++)
+        acc += decimTaps[k] * (p[2 * k] + p[DECIM_TAPS - 1 - 2 * k]);
+      acc >>= 15;
+      out[m] = (short)(acc > 32767 ? 32767 : (acc < -32768 ? -32768 : acc));
+    }
+    memmove(x, x + n, (DECIM_TAPS - 1) * sizeof(short));
+    return n / 2;
+  }
+
+private:
+  short x[DECIM_TAPS - 1 + MAXN];   // the last DECIM_TAPS - 1 samples, then the input
+};
+
+#endif
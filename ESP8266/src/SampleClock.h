@@ -0,0 +1,58 @@
+#ifndef SAMPLE_CLOCK_H
+#define SAMPLE_CLOCK_H
+
+#include <stdint.h>
+
+// Sample timer schedule for any rate. A rate that doesn't divide the timer
+// clock gets periods of clockHz / rate ticks, one tick longer whenever the
+// remainders add up to a whole tick, so n samples always take n * clockHz /
+// rate ticks rounded down: no drift, whatever the rate.
+//
+// The timer reloads its last load value when it fires. tick(), called from
+// the interrupt, loads the next period when it differs, less the ticks the
+// interrupt took to get there, so the latency doesn't add up either. Timer
+// has count(), the ticks left, counting down from the last load(), and
+// load(ticks), which restarts the count.
+
+class SampleClock
+{
+public:
+  void begin(uint32_t clockHz, uint32_t rate)
+  {
+    this->rate = rate;
+    base = clockHz / rate;
+    frac = clockHz % rate;
+    acc = 0;
+    loaded = base;
+  }
+
+  // ticks to load before starting the timer
+  uint32_t first() const { return loaded; }
+
+  template <class Timer>
+  inline __attribute__((always_inline)) void tick(Timer &timer)
+  {
+    uint32_t period = base;
+
+    // the period the timer started counting when it fired
+    acc += frac;
+    if (acc >= rate)
+    {
+      acc -= rate;
+      period++;
+    }
+    if (period != loaded)
+    {
+      uint32_t elapsed = loaded - timer.count();
+
+      loaded = period - elapsed;
+      timer.load(loaded);
+    }
+  }
+
+private:
+  uint32_t rate, base, frac, acc;
+  uint32_t loaded;    // what the timer reloads with when it fires
+};
+
+#endif
@@ -1,39 +1,119 @@
 #include <Arduino.h>
+#include <SPI.h>
+
+#include "adc3201.h"
+#include "mcp3201.h"
 
 #define ADC_CLK 16
 #define ADC_D    5
 #define ADC_CS   4
 
-void adcSetup()
-{
-  pinMode(ADC_CLK, OUTPUT);      // sets the digital pin 13 as output
-  pinMode(ADC_D, INPUT);
-  pinMode(ADC_CS, OUTPUT);      // sets the digital pin 13 as output
-}
+// the HSPI backend clocks the converter from the HSPI pins instead, CLK on
+// GPIO14 and DOUT on GPIO12 (MISO); CS stays on ADC_CS, as the hardware CS
+// pin, GPIO15, is the I2S bit clock
 
-short adcRead()
+// GPIO backend: straight to the output set/clear and input registers, no
+// digitalWrite(). GPIO16 is not in GPOS/GPOC, it has its own register.
+struct GpioPort
 {
-  digitalWrite(ADC_CS, LOW);
+  uint32_t edge;    // cycle count at the last edge
+
+  inline __attribute__((always_inline)) void cs(int level)
+  {
+    if (level)
+      GPOS = 1 << ADC_CS;
+    else
+      GPOC = 1 << ADC_CS;
+    edge = ESP.getCycleCount();
+  }
+
+  inline __attribute__((always_inline)) void clk(int level)
+  {
+    if (level)
+      GP16O |= 1;
+    else
+      GP16O &= ~1;
+    edge = ESP.getCycleCount();
+  }
 
-  digitalWrite(ADC_CLK, LOW);
+  inline __attribute__((always_inline)) int dout()
+  {
+    return (GPI >> ADC_D) & 1;
+  }
 
-  digitalWrite(ADC_CLK, HIGH );
-  digitalWrite(ADC_CLK, LOW);
+  inline __attribute__((always_inline)) void wait(int ns)
+  {
+    uint32_t cycles = (uint32_t)ns * clockCyclesPerMicrosecond() / 1000;
 
-  digitalWrite(ADC_CLK, HIGH );
-  digitalWrite(ADC_CLK, LOW);
+    while (ESP.getCycleCount() - edge < cycles)
+      ;
+  }
+};
 
-  unsigned short v=0;
-  for(int i=0;i<13;i++)
+// HSPI backend: one 16 bit transfer per sample, started by the previous
+// call. The first byte clocked in lands in the low byte of SPI1W0.
+struct HspiPort : GpioPort
+{
+  inline __attribute__((always_inline)) int busy()
   {
-    digitalWrite(ADC_CLK, HIGH );
+    return (SPI1CMD & SPIBUSY) != 0;
+  }
 
+  inline __attribute__((always_inline)) unsigned word()
+  {
+    uint32_t w = SPI1W0;
 
-    v = (v <<1)  | digitalRead(ADC_D);
+    return ((w & 0xff) << 8) | ((w >> 8) & 0xff);
+  }
 
+  inline __attribute__((always_inline)) void start()
+  {
+    SPI1CMD |= SPIBUSY;
+  }
+};
+
+static short ICACHE_RAM_ATTR adcReadGpio()
+{
+  GpioPort port;
+
+  return mcp3201_bitbang(port);
+}
+
+static short ICACHE_RAM_ATTR adcReadHspi()
+{
+  HspiPort spi;
+
+  return mcp3201_spi(spi);
+}
+
+static short (*adcReadFn)() = adcReadGpio;
+
+void adcSetup(int backend)
+{
+  if (backend == ADC_BACKEND_HSPI)
+  {
+    pinMode(ADC_CS, OUTPUT);
+    digitalWrite(ADC_CS, HIGH);
+    SPI.begin();
+    SPI.setDataMode(SPI_MODE0);
+    SPI.setBitOrder(MSBFIRST);
+    SPI.setFrequency(MCP3201_SPI_HZ);
+    SPI1U1 = ((MCP3201_SPI_BITS - 1) << SPILMOSI) | ((MCP3201_SPI_BITS - 1) << SPILMISO);
+    SPI1W0 = 0;
+    adcReadFn = adcReadHspi;
+  }
+  else
+  {
+    pinMode(ADC_CLK, OUTPUT);
+    pinMode(ADC_D, INPUT);
+    pinMode(ADC_CS, OUTPUT);
+    digitalWrite(ADC_CS, HIGH);
     digitalWrite(ADC_CLK, LOW);
+    adcReadFn = adcReadGpio;
   }
-  digitalWrite(ADC_CS, HIGH );
+}
 
-  return v;
+short ICACHE_RAM_ATTR adcRead()
+{
+  return adcReadFn();
 }
@@ -1,2 +1,11 @@
-void adcSetup();
+// MCP3201 driver backends. ADC_BACKEND_GPIO bit-bangs the converter
+// through the GPIO registers from IRAM, on the ADC_CLK/ADC_D/ADC_CS pins
+// of adc3201.cpp, in about 20 us per sample at the converter's 0.8 MHz.
+// ADC_BACKEND_HSPI has the HSPI peripheral clock it, CLK and DOUT on the
+// HSPI pins: a sample costs the interrupt a few register accesses and a
+// 0.7 us CS pulse, and comes one adcRead() late.
+#define ADC_BACKEND_GPIO  0
+#define ADC_BACKEND_HSPI  1
+
+void adcSetup(int backend);
 short adcRead();
@@ -0,0 +1,75 @@
+#ifndef MCP3201_H
+#define MCP3201_H
+
+// MCP3201 conversion protocol, shared by the backends of adc3201.cpp and
+// the simulated converter of host/adcsim.cpp.
+//
+// CS falling starts a conversion: the input is sampled during the first
+// 1.5 clocks, the null bit comes out on the falling edge of the second
+// clock and B11..B0 on the next 12 falling edges, MSB first. Each bit is
+// read on the rising edge that follows. Clocked further, the converter
+// repeats B1..B11 LSB first, so a 16 bit SPI transfer (mode 0) holds the
+// null bit in bit 13 and the sample in bits 12..1.
+
+#define MCP3201_BITS      12
+#define MCP3201_CLOCKS    15      // 2 sample clocks, the null bit and B11..B0
+#define MCP3201_SPI_BITS  16      // 2 bytes, the last bit is B1 again
+
+// Timing in ns. The clock limits are the datasheet's for 2.7 V, which
+// cover a converter powered from 3.3 V: 0.8 MHz at most.
+#define MCP3201_T_SUCS    100     // CS fall to the first rising clock edge
+#define MCP3201_T_HI      625     // clock high
+#define MCP3201_T_LO      625     // clock low
+#define MCP3201_T_DO      200     // clock fall to the output bit valid
+#define MCP3201_T_CSH     625     // CS high between conversions
+#define MCP3201_SPI_HZ    800000
+
+// One conversion bit-banged through a Port that has cs(level), clk(level),
+// dout(), and wait(ns), which returns once ns have passed since the last
+// cs() or clk() edge. Always inlined, so it runs from the caller's IRAM.
+template <class Port>
+inline __attribute__((always_inline)) short mcp3201_bitbang(Port &port)
+{
+  unsigned v = 0;
+
+  port.cs(0);
+  port.wait(MCP3201_T_SUCS);
+  for (int i = 0; i < MCP3201_CLOCKS; i++)
+  {
+    port.clk(1);
+    if (i >= 2)
+      v = (v << 1) | port.dout();
+    port.wait(MCP3201_T_HI);
+    port.clk(0);
+    port.wait(MCP3201_T_LO);
+  }
+  port.cs(1);
+
+  return v;
+}
+
+// One conversion through an SPI peripheral, pipelined: returns the sample
+// of the transfer started by the previous call and starts the next one, so
+// the interrupt never waits for the 16 clocks and the samples come one
+// call late. CS stays low from one call to the next; the converter holds
+// its output meanwhile. Spi has the cs() and wait() of a bit-bang Port,
+// and busy(), word(), the bits of the last transfer with the first one in
+// bit 15, and start().
+template <class Spi>
+inline __attribute__((always_inline)) short mcp3201_spi(Spi &spi)
+{
+  unsigned w;
+
+  while (spi.busy())
+    ;
+  w = spi.word();
+  spi.cs(1);
+  spi.wait(MCP3201_T_CSH);
+  spi.cs(0);
+  spi.wait(MCP3201_T_SUCS);
+  spi.start();
+
+  return (w >> 1) & ((1 << MCP3201_BITS) - 1);
+}
+
+#endif
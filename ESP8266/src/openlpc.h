@@ -19,13 +19,134 @@ typedef struct openlpc_d_state openlpc_decoder_state;
 openlpc_encoder_state *create_openlpc_encoder_state(void);
 void init_openlpc_encoder_state(openlpc_encoder_state *st, int framelen);
 int  openlpc_encode(const short *in, unsigned char *out, openlpc_encoder_state *st);
+int  openlpc_encoder_state_size(const openlpc_encoder_state *st);
 void destroy_openlpc_encoder_state(openlpc_encoder_state *st);
 
 openlpc_decoder_state *create_openlpc_decoder_state(void);
 void init_openlpc_decoder_state(openlpc_decoder_state *st, int framelen);
-int  openlpc_decode(unsigned char *in, short *out, openlpc_decoder_state *st);
+int  openlpc_decode(const unsigned char *in, short *out, openlpc_decoder_state *st);
+int  openlpc_decoder_state_size(const openlpc_decoder_state *st);
 void destroy_openlpc_decoder_state(openlpc_decoder_state *st);
 
+/* Bits per frame for the ten LPC coefficients. A frame is the two bytes
+   of period and gain plus these, rounded up to bytes: OPENLPC_BITS_38 is
+   what init_openlpc_encoder_state()/init_openlpc_decoder_state() use and
+   gives OPENLPC_ENCODED_FRAME_SIZE bytes, OPENLPC_BITS_32 gives 6 bytes
+   for low bandwidth links and OPENLPC_BITS_80 12. 160 samples at 38 bits
+   and OPENLPC_FRAMESIZE_1_4 samples at 32 bits have code specialized for
+   that frame length, other frame lengths share a generic version.
+   openlpc_encoded_frame_size() returns the bytes per frame, or -1 if
+   lpcbits is not supported. */
+#define OPENLPC_BITS_38     38
+#define OPENLPC_BITS_32     32
+#define OPENLPC_BITS_80     80
+#define OPENLPC_MAX_ENCODED_FRAME_SIZE  12
+
+/* Options or'ed into lpcbits, on top of OPENLPC_BITS_38 or OPENLPC_BITS_32,
+   generic frame length only. OPENLPC_EXACT_FILTERS runs the prefilters with
+   fixed point multiplies by the coefficients of the float codec instead of
+   their shift-and-add approximations; OPENLPC_LINEAR_Q quantizes k[1] and
+   k[2] linearly instead of on the arcsine scale, as the original codec
+   did. Both sides of a link must use the same options. */
+#define OPENLPC_EXACT_FILTERS   0x100
+#define OPENLPC_LINEAR_Q        0x200
+
+void init_openlpc_encoder_state_bits(openlpc_encoder_state *st, int framelen, int lpcbits);
+void init_openlpc_decoder_state_bits(openlpc_decoder_state *st, int framelen, int lpcbits);
+int  openlpc_encoded_frame_size(int lpcbits);
+
+/* Low delay encoder. A frame is only sent once all its samples are in, so
+   the algorithmic delay of the codec is one frame, 20 ms at 160 samples:
+   the analysis has no lookahead and the decoder plays each frame as soon
+   as it is decoded. init_openlpc_encoder_state_low_delay() sets up frames
+   of OPENLPC_FRAMESIZE_LOW_DELAY samples, 10 ms, with the analysis still
+   spanning 3 frames: the LPC window is the last 2 frames, its
+   autocorrelation averaged with the one of the previous frame, and the
+   pitch is picked over the last 2 frames, the older pitch region being
+   the newer one of the previous frame. The frames are the usual ones, for
+   a decoder set up with the same frame length; twice as many of them are
+   sent, for a bit less quality than 160 samples. */
+#define OPENLPC_FRAMESIZE_LOW_DELAY 80
+
+void init_openlpc_encoder_state_low_delay(openlpc_encoder_state *st, int framelen, int lpcbits);
+
+/* Synthesis arithmetic, picked at init. OPENLPC_SYNTH_Q20 is the 32 bit
+   lattice of init_openlpc_decoder_state(). OPENLPC_SYNTH_Q15 keeps the
+   lattice in 16 bits so every product is a 16x16 multiply, which the
+   ESP8266 does in one instruction where a 32x32 one is a libgcc call; it
+   is cheaper and less accurate, for when the CPU is also encoding. */
+#define OPENLPC_SYNTH_Q20   0
+#define OPENLPC_SYNTH_Q15   1
+
+void init_openlpc_decoder_state_synth(openlpc_decoder_state *st, int framelen, int lpcbits, int synth);
+
+/* Batch versions: encode 'frames' consecutive frames of framelen samples
+   into frames * openlpc_encoded_frame_size() bytes, or decode them back.
+   The decoder only loads and stores its filter state once per call, so
+   this is faster than a loop around openlpc_decode(). Return the number
+   of bytes, resp. samples, written. */
+int  openlpc_encode_frames(const short *in, int frames, unsigned char *out, openlpc_encoder_state *st);
+int  openlpc_decode_frames(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st);
+
+/* Push encoder, for samples as they are captured: openlpc_encoder_push()
+   takes any number of samples and runs the prefilters on them at once,
+   and the rest of the analysis whenever they complete a frame, so the
+   per-sample work is spread over the capture blocks instead of coming in
+   one burst per frame. Each frame completed is written to out, which
+   needs room for n / framelen + 1 frames; returns the number of bytes
+   written. openlpc_encoder_push_dtx() also leaves out the frames
+   openlpc_encode_dtx() would not send. Calls to openlpc_encode() or
+   openlpc_encode_frames() on the same state must come at frame
+   boundaries. */
+int  openlpc_encoder_push(const short *in, int n, unsigned char *out, openlpc_encoder_state *st);
+int  openlpc_encoder_push_dtx(const short *in, int n, unsigned char *out, openlpc_encoder_state *st);
+
+/* Discontinuous transmission. openlpc_encode_dtx() encodes one frame like
+   openlpc_encode() and returns the bytes to send, or 0 for a frame of
+   silence that need not be sent. The first frame of a silence and then
+   every OPENLPC_SID_FRAMES frames are still sent, as silence descriptors
+   with the level and spectrum of the background noise. For each frame
+   that was not sent the receiver calls openlpc_decode_cng(), which plays
+   comfort noise shaped like the last frame decoded. */
+#define OPENLPC_SID_FRAMES  16
+
+int  openlpc_encode_dtx(const short *in, unsigned char *out, openlpc_encoder_state *st);
+int  openlpc_decode_cng(short *out, openlpc_decoder_state *st);
+
+/* Packet loss concealment. openlpc_decode_lost() makes up a frame that did
+   not arrive from the last one decoded: the first lost frames keep its
+   voicing and spectrum, the gain fades towards the level of the background
+   noise and the excitation turns to noise, so a burst of losses ends up as
+   comfort noise. Returns the number of samples written. */
+int  openlpc_decode_lost(short *out, openlpc_decoder_state *st);
+
+/* Multi-channel decoder: decodes one frame of each of 'channels' streams
+   per call, in lockstep, so the synthesis lattice runs across channels in
+   SIMD lanes. init_openlpc_multi_decoder_state() takes OPENLPC_BITS_38
+   frames, init_openlpc_multi_decoder_state_bits() the lpcbits of all the
+   streams. Frame c is read from in + c * openlpc_encoded_frame_size(lpcbits)
+   and decoded to out + c * framelen. Returns the number of samples written,
+   0 if the init failed. */
+typedef struct openlpc_md_state openlpc_multi_decoder_state;
+
+openlpc_multi_decoder_state *create_openlpc_multi_decoder_state(int channels);
+void init_openlpc_multi_decoder_state(openlpc_multi_decoder_state *st, int framelen);
+void init_openlpc_multi_decoder_state_bits(openlpc_multi_decoder_state *st, int framelen, int lpcbits);
+int  openlpc_decode_multi(const unsigned char *in, short *out, openlpc_multi_decoder_state *st);
+int  openlpc_multi_decoder_state_size(const openlpc_multi_decoder_state *st);
+void destroy_openlpc_multi_decoder_state(openlpc_multi_decoder_state *st);
+
+/* SIMD kernels for the analysis loops and the multi-channel lattice, only
+   available on x86 hosts. The best one the CPU supports is used by
+   default; openlpc_set_kernels() returns -1 if the backend is not
+   supported. Not thread safe. */
+#define OPENLPC_KERNELS_SCALAR  0
+#define OPENLPC_KERNELS_SSE41   1
+#define OPENLPC_KERNELS_AVX2    2
+
+int  openlpc_set_kernels(int backend);
+int  openlpc_get_kernels(void);
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -0,0 +1,123 @@
+/*
+ * Precomputed parameter dequantization for the fixed point OpenLPC decoder.
+ *
+ * The values the decoder used to compute per frame with fixexp32() and
+ * fixsin32(), bit for bit, indexed by the received byte:
+ *   dequant_per[i]    REAL_MINPER * fixexp32(i / 256 * log(MAXPER / MINPER))
+ *   dequant_gain[i]   (fixexp32(i / 256) - 1) / ((2.718 - 1) / 10)
+ *   dequant_arcsin[i] fixsin32(PI / 2 * (signed char)i / 128)
+ * Included by openlpc_fixed.cpp only.
+ */
+
+#ifndef OPENLPC_DEQUANT_H
+#define OPENLPC_DEQUANT_H
+
+/* pitch period for parm[0] */
+static const fixed32 dequant_per[256] PROGMEM = {
+            0,  26428975,  26645350,  26863500,  27083400,  27305125,  27528675,  27754025,
+     27981250,  28210325,  28441250,  28674125,  28908850,  29145525,  29384125,  29624675,
+     29867225,  30111725,  30358250,  30606775,  30857325,  31109975,  31364650,  31621400,
+     31880300,  32141275,  32404425,  32669700,  32937150,  33206800,  33478650,  33752750,
+     34029050,  34307625,  34588500,  34871650,  35157175,  35444975,  35735125,  36027700,
+     36322625,  36620025,  36919800,  37222025,  37526775,  37833975,  38143700,  38456000,
+     38770800,  39088225,  39408200,  39730825,  40056100,  40384025,  40714650,  41047950,
+     41383975,  41722800,  42064325,  42408725,  42755900,  43105900,  43458825,  43814625,
+     44173350,  44534950,  44899525,  45267150,  45637700,  46011300,  46388025,  46767775,
+     47150650,  47536650,  47925775,  48318175,  48713700,  49112525,  49514575,  49919950,
+     50328625,  50740650,  51156075,  51574850,  51997050,  52422750,  52851925,  53284575,
+     53720825,  54160625,  54604000,  55051025,  55501700,  55956075,  56414175,  56876075,
+     57341675,  57811050,  58284400,  58761550,  59242600,  59727575,  60216550,  60709550,
+     61206525,  61707650,  62212825,  62722100,  63235600,  63753300,  64275150,  64801400,
+     65331900,  65866750,  66405975,  66949600,  67497700,  68050275,  68607425,  69169050,
+     69735275,  70306225,  70881750,  71462200,  72047150,  72636950,  73231650,  73831175,
+     74435650,  75045025,  75659350,  76278775,  76903225,  77532800,  78167575,  78807450,
+     79452650,  80103125,  80758850,  81420000,  82086600,  82758625,  83436075,  84119125,
+     84807875,  85502125,  86202150,  86907800,  87619250,  88336600,  89059800,  89788850,
+     90524000,  91265000,  92012250,  92765425,  93524850,  94290600,  95062450,  95840750,
+     96625400,  97416350,  98213950,  99017950,  99828625, 100645875, 101469775, 102300475,
+    103137975, 103982425, 104833650, 105691800, 106557100, 107429400, 108308900, 109195600,
+    110089525, 110990825, 111899425, 112815475, 113739150, 114670225, 115609050, 116555425,
+    117509700, 118471700, 119441525, 120419425, 121405300, 122399100, 123401200, 124411375,
+    125429950, 126456825, 127491975, 128535875, 129588075, 130648875, 131718550, 132796850,
+    133884100, 134980100, 136085050, 137199200, 138322425, 139454950, 140596550, 141747450,
+    142907975, 144077925, 145257500, 146446600, 147645450, 148854275, 150072850, 151301400,
+    152540125, 153788850, 155047975, 156317175, 157596925, 158887200, 160187800, 161499350,
+    162821450, 164154300, 165498375, 166853075, 168219200, 169596200, 170984625, 172384475,
+    173795750, 175218575, 176652950, 178099075, 179557300, 181027175, 182509050, 184003350,
+    185509650, 187028400, 188559450, 190103050, 191659425, 193228475, 194810775, 196405500,
+    198013375, 199634525, 201268800, 202916550, 204577800, 206252525, 207941125, 209643375,
+};
+
+/* gain for parm[1], the voicing bits included */
+static const fixed32 dequant_gain[256] PROGMEM = {
+            0,     23888,     47869,     71944,     96111,    120378,    144738,    169191,
+       193743,    218388,    243132,    267974,    292910,    317945,    343074,    368306,
+       393638,    419063,    444593,    470222,    495949,    521782,    547713,    573743,
+       599878,    626112,    652451,    678895,    705443,    732091,    758843,    785700,
+       812667,    839733,    866910,    894192,    921579,    949076,    976678,   1004390,
+      1032208,   1060135,   1088174,   1116323,   1144577,   1172947,   1201428,   1230014,
+      1258721,   1287534,   1316463,   1345503,   1374659,   1403925,   1433309,   1462808,
+      1492418,   1522150,   1551993,   1581958,   1612040,   1642232,   1672552,   1702983,
+      1733542,   1764211,   1795003,   1825917,   1856953,   1888112,   1919386,   1950789,
+      1982314,   2013962,   2045731,   2077629,   2109643,   2141791,   2174061,   2206459,
+      2238985,   2271634,   2304416,   2337321,   2370359,   2403526,   2436820,   2470243,
+      2503800,   2537490,   2571308,   2605261,   2639347,   2673561,   2707915,   2742403,
+      2777025,   2811780,   2846676,   2881705,   2916874,   2952176,   2987619,   3023201,
+      3058923,   3094784,   3130786,   3166927,   3203207,   3239633,   3276199,   3312911,
+      3349767,   3386764,   3423906,   3461200,   3498633,   3536211,   3573941,   3611817,
+      3649844,   3688016,   3726340,   3764809,   3803435,   3842207,   3881136,   3920211,
+      3959443,   3998837,   4038378,   4078069,   4117912,   4157924,   4198087,   4238401,
+      4278879,   4319513,   4360311,   4401265,   4442377,   4483658,   4525084,   4566685,
+      4608454,   4650370,   4692459,   4734718,   4777134,   4819724,   4862477,   4905393,
+      4948484,   4991738,   5035161,   5078758,   5122530,   5166465,   5210574,   5254853,
+      5299312,   5343939,   5388747,   5433724,   5478881,   5524213,   5569719,   5615412,
+      5661274,   5707322,   5753550,   5799959,   5846542,   5893317,   5940273,   5987404,
+      6034732,   6082235,   6129930,   6177812,   6225879,   6274133,   6322579,   6371217,
+      6420035,   6469052,   6518255,   6567661,   6617254,   6667032,   6717027,   6767196,
+      6817580,   6868145,   6918913,   6969879,   7021049,   7072423,   7123983,   7175759,
+      7227732,   7279915,   7332290,   7384880,   7437663,   7490666,   7543874,   7597285,
+      7650911,   7704741,   7758793,   7813042,   7867512,   7922198,   7977087,   8032192,
+      8087518,   8143066,   8198822,   8254800,   8311000,   8367408,   8424050,   8480907,
+      8537991,   8595290,   8652828,   8710581,   8768562,   8826769,   8885203,   8943865,
+      9002765,   9061886,   9121246,   9180833,   9240646,   9300705,   9360990,   9421514,
+      9482283,   9543278,   9604518,   9666002,   9727720,   9789675,   9851882,   9914332,
+      9977027,  10039961,  10103145,  10166574,  10230253,  10294182,  10358361,  10422785,
+};
+
+/* k[1] and k[2] for the code (signed char)i */
+static const fixed32 dequant_arcsin[256] PROGMEM = {
+            0,     12866,     25732,     38594,     51450,     64298,     77137,     89964,
+       102777,    115575,    128356,    141117,    153857,    166574,    179266,    191930,
+       204566,    217171,    229743,    242281,    254782,    267245,    279668,    292048,
+       304385,    316675,    328917,    341111,    353253,    365342,    377376,    389353,
+       401271,    413129,    424925,    436657,    448322,    459921,    471450,    482908,
+       494294,    505605,    516840,    527997,    539074,    550071,    560984,    571813,
+       582557,    593212,    603778,    614252,    624634,    634923,    645115,    655210,
+       665207,    675105,    684899,    694591,    704178,    713660,    723034,    732299,
+       741453,    750496,    759426,    768242,    776942,    785525,    793989,    802334,
+       810559,    818660,    826639,    834492,    842221,    849823,    857296,    864641,
+       871856,    878939,    885890,    892708,    899391,    905937,    912348,    918623,
+       924757,    930754,    936608,    942324,    947896,    953325,    958614,    963757,
+       968753,    973604,    978309,    982865,    987274,    991535,    995647,    999607,
+      1003415,   1007077,   1010588,   1013941,   1017146,   1020194,   1023093,   1025831,
+      1028418,   1030851,   1033124,   1035246,   1037223,   1039033,   1040683,   1042181,
+      1043515,   1044699,   1045723,   1046585,   1047294,   1047869,   1048256,   1048487,
+     -1048573,  -1048489,  -1048258,  -1047869,  -1047299,  -1046586,  -1045723,  -1044699,
+     -1043515,  -1042182,  -1040685,  -1039033,  -1037223,  -1035246,  -1033126,  -1030851,
+     -1028419,  -1025835,  -1023093,  -1020196,  -1017146,  -1013942,  -1010590,  -1007077,
+     -1003417,   -999608,   -995647,   -991536,   -987276,   -982867,   -978311,   -973605,
+      -968755,   -963758,   -958615,   -953327,   -947898,   -942326,   -936609,   -930756,
+      -924759,   -918624,   -912350,   -905939,   -899393,   -892709,   -885892,   -878940,
+      -871857,   -864643,   -857298,   -849824,   -842223,   -834494,   -826641,   -818662,
+      -810560,   -802336,   -793991,   -785527,   -776943,   -768244,   -759427,   -750497,
+      -741455,   -732301,   -723035,   -713662,   -704180,   -694593,   -684901,   -675106,
+      -665209,   -655212,   -645117,   -634924,   -624636,   -614254,   -603779,   -593214,
+      -582559,   -571815,   -560986,   -550073,   -539076,   -527999,   -516842,   -505607,
+      -494296,   -482910,   -471452,   -459923,   -448324,   -436659,   -424927,   -413131,
+      -401273,   -389355,   -377378,   -365344,   -353255,   -341113,   -328919,   -316677,
+      -304387,   -292050,   -279670,   -267247,   -254784,   -242283,   -229745,   -217173,
+      -204568,   -191932,   -179268,   -166576,   -153859,   -141119,   -128358,   -115577,
+      -102779,    -89966,    -77139,    -64300,    -51452,    -38596,    -25734,    -12868,
+};
+
+#endif /* OPENLPC_DEQUANT_H */
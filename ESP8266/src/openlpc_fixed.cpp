@@ -109,9 +109,19 @@
 #include <malloc.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include "openlpc.h"
 
-#define fixed32         long
+#ifdef ARDUINO
+#include <pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_dword(addr)    (*(const uint32_t *)(addr))
+#endif
+
+/* fixed32 must be exactly 32 bits wide: the quantizer and the filters rely on
+   the same wraparound as on the ESP8266, where long is 32 bits */
+#define fixed32         int32_t
 
 #if defined WIN32 || defined WIN64 || defined (_WIN32_WCE)
 #define fixed64         __int64
@@ -119,10 +129,17 @@
 #define fixed64         long long
 #endif
 
+/* Per-stage timing hooks, only compiled in by the host benchmark */
+#ifdef OPENLPC_PROFILE
+#include "openlpc_prof.h"
+#else
+#define PROF_BEGIN()
+#define PROF_MARK(stage)
+#endif
+
 /* These are for development and debugging and should not be changed unless
 you REALLY know what you are doing ;) */
 #define IGNORE_OVERFLOW
-#define FAST_FILTERS
 #define PRECISION       20
 
 #define ftofix32(x)       ((fixed32)((x) * (float)(1 << PRECISION) + ((x) < 0 ? -0.5 : 0.5)))
@@ -370,90 +387,633 @@ __inline fixed32 fixasin32(fixed32 x)
 
 #define PREEMPH
 
-#define bcopy(a, b, n)    memmove(b, a, n)
-
 #define LPC_FILTORDER   10
 #define FS              8000.0  /* Sampling rate */
 #define MAXWINDOW       1000    /* Max analysis window length */
 
+#include "openlpc_window.h"
+
+#define FC      200.0   /* Pitch analyzer filter cutoff */
+#define DOWN        5   /* Decimation for pitch analyzer */
+#define MINPIT      40.0    /* Minimum pitch (observed: 74) */
+#define MAXPIT      320.0   /* Maximum pitch (observed: 250) */
+
+#define MINPER      (int)(FS / (DOWN * MAXPIT) + .5)    /* Minimum period  */
+#define MAXPER      (int)(FS / (DOWN * MINPIT) + .5)    /* Maximum period  */
+
+#define REAL_MINPER  (DOWN * MINPER) /* converted to samples units */
+
+#define PITCH_DIRECT        0   /* two independent autocorrelations per frame */
+#define PITCH_SHARED        1   /* products in the overlapping half computed once */
+#define PITCH_INCREMENTAL   2   /* also reuses the last half of the previous frame */
+
+#ifndef PITCH_ENGINE
+#define PITCH_ENGINE    PITCH_SHARED
+#endif
 
+#define PITCH_LAGS  (MAXPER + 2)    /* the peak search looks one lag past MAXPER */
+
+
+/* s[] and y[] hold the last buflen samples as a ring: pos is the index of
+   the oldest one, i.e. of the start of the analysis window. Each frame
+   overwrites the framelen oldest samples, so nothing has to be shifted.
+   The buffers are sized from framelen by init_openlpc_encoder_state and
+   live in a single heap block; h[] points to a shared table in flash for
+   the standard frame lengths.
+   The LPC window is the newest winlen samples of the ring and each pitch
+   region pitchlen samples, the first one starting at pos and the second
+   one ending with the frame. They are the whole ring and framelen, except
+   in low delay mode, see init_openlpc_encoder_state_low_delay(). */
 typedef struct openlpc_e_state{
-    int     framelen, buflen;
-    fixed32 s[MAXWINDOW], y[MAXWINDOW], h[MAXWINDOW];
+    int     framelen, buflen, pos;
+    int     winlen, pitchlen;
+    int     low_delay;
+    int     fill;           /* samples of the next frame pushed so far */
+    fixed32 *s;             /* prefiltered and preemphasized signal */
+    short   *y;             /* low-passed signal for the pitch detector, Q15 */
+    fixed32 *w;             /* windowed signal, ANALYSIS_MULTIPASS only */
+    const fixed32 *h;       /* first (winlen + 1) / 2 taps of the window */
+    void    *mem;           /* s[], y[], w[] and, if not shared, h[] */
+    int     memsize;
     fixed32 xv1[3], yv1[3],
             xv2[2], yv2[2],
             xv3[1], yv3[3],
             xv4[2], yv4[2];
-    fixed32 w[MAXWINDOW], r[LPC_FILTORDER+1];
+    fixed32 r[LPC_FILTORDER+1];
+    fixed32 r_last[LPC_FILTORDER+1];    /* low delay: previous window's */
+    fixed32 per_track;      /* low delay: pitch of the newest region */
+#if PITCH_ENGINE == PITCH_INCREMENTAL
+    fixed64 pitch_auto[PITCH_LAGS]; /* last half of the previous window */
+#endif
+    fixed32 logmaxminper;
+    fixed32 vad_floor;      /* background noise energy, for openlpc_encode_dtx() */
+    int     vad_hang;       /* frames still sent after the last speech frame */
+    int     dtx_count;      /* frames of silence so far */
+    int (*encode_frames)(const short *in, int frames, unsigned char *out, struct openlpc_e_state *st);
+    int (*push)(const short *in, int n, unsigned char *out, int dtx, struct openlpc_e_state *st);
 } openlpc_e_state_t;
 
+#define MIDTAP 1
+#define MAXTAP 4
+
+/* The voiced excitation ramps down by NewG / Newper * gainadj / 2 each
+   sample. SYNTH_EXACT divides at every sample and gives the same samples as
+   the original decoder; SYNTH_FAST divides once per half frame for
+   1 / Newper and follows the interpolated period with a Newton step, which
+   only multiplies. */
+#define SYNTH_EXACT     0
+#define SYNTH_FAST      1
+
+#ifndef SYNTH_MODE
+#define SYNTH_MODE      SYNTH_FAST
+#endif
+
+/* state of random16(), the unvoiced excitation generator */
+typedef struct openlpc_random{
+    short y[MAXTAP+1];
+    int j, k;
+} openlpc_random_t;
+
 typedef struct openlpc_d_state{
     fixed32 Oldper, OldG, Oldk[LPC_FILTORDER + 1];
     fixed32 bp[LPC_FILTORDER+1];
     fixed32 exc;
     fixed32 gainadj;
     int pitchctr, framelen, buflen;
+    openlpc_random_t rnd;
+    unsigned char lastparm[OPENLPC_MAX_ENCODED_FRAME_SIZE];    /* for openlpc_decode_cng() */
+    fixed32 noiseG;         /* background gain, for openlpc_decode_lost() */
+    int lost;               /* frames lost in a row */
+    int (*decode_frames)(const unsigned char *in, int frames, short *out, struct openlpc_d_state *st);
 } openlpc_d_state_t;
 
-#define FC      200.0   /* Pitch analyzer filter cutoff */
-#define DOWN        5   /* Decimation for pitch analyzer */
-#define MINPIT      40.0    /* Minimum pitch (observed: 74) */
-#define MAXPIT      320.0   /* Maximum pitch (observed: 250) */
-
-#define MINPER      (int)(FS / (DOWN * MAXPIT) + .5)    /* Minimum period  */
-#define MAXPER      (int)(FS / (DOWN * MINPIT) + .5)    /* Maximum period  */
-
-#define REAL_MINPER  (DOWN * MINPER) /* converted to samples units */
+/* The multi-channel decoder runs 'channels' decoders in lockstep. The
+   excitation is branchy and stays per channel; the lattice state is laid
+   out by stage, bp[m * stride + c], so lattice() runs one stage of all
+   the channels in SIMD lanes. */
+typedef struct openlpc_md_channel{
+    fixed32 Oldper, OldG, exc;
+    int pitchctr;
+    openlpc_random_t rnd;
+    fixed32 hper[2], gain;                      /* current frame */
+    fixed32 Newper, NewG, Ginc, perinc, gainadj, rper; /* current half frame */
+} openlpc_md_channel_t;
+
+typedef struct openlpc_md_state{
+    int channels, stride;   /* stride is channels rounded up to 8 */
+    int framelen, buflen;
+    fixed32 gainadj;
+    int sizeofparm;
+    void (*dequantize)(const unsigned char *parm, fixed32 hper[2], fixed32 *gain, fixed32 k[]);
+    openlpc_md_channel_t *ch;
+    fixed32 *bp, *Oldk, *Newk, *kinc;   /* (LPC_FILTORDER + 1) * stride each */
+    fixed32 *u;                         /* excitation in, output sample out */
+    void    *mem;
+    int     memsize;
+} openlpc_md_state_t;
 
 #define WSCALE      1.5863  /* Energy loss due to windowing */
 
-#define BITS_FOR_LPC 38
+/* openlpc_decode_lost(): the gain loses 30% of the way to the background
+   each lost frame, and the excitation is noise from the third one */
+#define PLC_DECAY       ftofix32(0.7)
+#define PLC_VOICED      2
 
-#define ARCSIN_Q /* provides better quantization of first two k[] at low bitrates */
+/* openlpc_encode_dtx() */
+#define VAD_RATIO       4       /* speech is 6 dB over the noise */
+#define VAD_HANGOVER    960     /* samples, so word endings are not clipped */
+#define VAD_MIN_FLOOR   ftofix32(0.0001)
+
+/* Bits for k[1]..k[10], by bits per frame */
+template <int lpcbits> struct lpc_bits;
 
-#if BITS_FOR_LPC == 38
 /* (38 bit LPC-10, 2.7 Kbit/s @ 20ms, 2.4 Kbit/s @ 22.5 ms */
-static int parambits[LPC_FILTORDER] = {6,5,5,4,4,3,3,3,3,2};
-#elif BITS_FOR_LPC == 32
+template <> struct lpc_bits<OPENLPC_BITS_38> {
+    static constexpr int parambits[LPC_FILTORDER] = {6,5,5,4,4,3,3,3,3,2};
+};
+constexpr int lpc_bits<OPENLPC_BITS_38>::parambits[LPC_FILTORDER];
+
 /* (32 bit LPC-10, 2.4 Kbit/s, not so good */
-static int parambits[LPC_FILTORDER] = {5,5,5,4,3,3,2,2,2,1};
-#else /* BITS_FOR_LPC == 80 */
+template <> struct lpc_bits<OPENLPC_BITS_32> {
+    static constexpr int parambits[LPC_FILTORDER] = {5,5,5,4,3,3,2,2,2,1};
+};
+constexpr int lpc_bits<OPENLPC_BITS_32>::parambits[LPC_FILTORDER];
+
 /* 80-bit LPC10, 4.8 Kbit/s */
-static int parambits[LPC_FILTORDER] = {8,8,8,8,8,8,8,8,8,8};
-#endif
+template <> struct lpc_bits<OPENLPC_BITS_80> {
+    static constexpr int parambits[LPC_FILTORDER] = {8,8,8,8,8,8,8,8,8,8};
+};
+constexpr int lpc_bits<OPENLPC_BITS_80>::parambits[LPC_FILTORDER];
+
+/* The quantized k[] are packed after the period and gain bytes as one
+   little endian bit string, k[1] in the most significant bits and k[10] in
+   the least: field i starts at bit lpc_bit_offset(bits, i), the bits of the
+   fields after it. lpc_layout<>::fields[] has where each field is in the
+   bytes. */
+static constexpr int lpc_bit_offset(const int *bits, int i)
+{
+    return i >= LPC_FILTORDER - 1 ? 0 : bits[i + 1] + lpc_bit_offset(bits, i + 1);
+}
+
+typedef struct lpc_field {
+    unsigned char byte;     /* index of the first byte in the frame */
+    unsigned char shift;    /* position of the field in that byte */
+    unsigned char bitc8;    /* 8 - bits of the field */
+    unsigned char spans;    /* the field goes on in the next byte */
+} lpc_field;
+
+#define LPC_FIELD(bits, i) { \
+    (unsigned char)(2 + lpc_bit_offset(bits, i) / 8), \
+    (unsigned char)(lpc_bit_offset(bits, i) % 8), \
+    (unsigned char)(8 - bits[i]), \
+    (unsigned char)(lpc_bit_offset(bits, i) % 8 + bits[i] > 8) }
+
+template <int lpcbits> struct lpc_layout {
+    static constexpr const int *bits = lpc_bits<lpcbits>::parambits;
+    static constexpr int size = (lpcbits + 7) / 8 + 2;     /* bytes per frame */
+    static constexpr lpc_field fields[LPC_FILTORDER] = {
+        LPC_FIELD(bits, 0), LPC_FIELD(bits, 1), LPC_FIELD(bits, 2), LPC_FIELD(bits, 3),
+        LPC_FIELD(bits, 4), LPC_FIELD(bits, 5), LPC_FIELD(bits, 6), LPC_FIELD(bits, 7),
+        LPC_FIELD(bits, 8), LPC_FIELD(bits, 9)
+    };
+
+    static_assert(lpc_bit_offset(bits, 0) + bits[0] == lpcbits, "parambits[] do not add up");
+    static_assert(size <= OPENLPC_MAX_ENCODED_FRAME_SIZE, "parambits[] do not fit in a frame");
+};
+template <int lpcbits> constexpr lpc_field lpc_layout<lpcbits>::fields[LPC_FILTORDER];
+
+/* A codec variant: the frame length, 0 if it is only known at run time,
+   the bits for k[], and whether to use the shift-and-add versions of the
+   prefilters and the arcsine quantization of k[1] and k[2], which is
+   better at low bitrates; OPENLPC_EXACT_FILTERS and OPENLPC_LINEAR_Q turn
+   them off. The encoder and decoder are instantiated for each variant in
+   variants[]. */
+template <int FRAMELEN, int LPCBITS, bool FAST_FILTERS = true, bool ARCSIN_Q = true>
+struct lpc_config {
+    static constexpr int framelen = FRAMELEN;
+    static constexpr bool fast_filters = FAST_FILTERS;
+    static constexpr bool arcsin_q = ARCSIN_Q;
+    typedef lpc_layout<LPCBITS> layout;
+};
+
+typedef struct lpc_variant {
+    int framelen;           /* 0 for any */
+    int lpcbits;
+    int size;               /* bytes per frame */
+    int (*encode_frames)(const short *in, int frames, unsigned char *out, openlpc_encoder_state *st);
+    int (*push)(const short *in, int n, unsigned char *out, int dtx, openlpc_encoder_state *st);
+    int (*decode_frames)(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st);
+    int (*decode_frames_q15)(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st);
+    void (*dequantize)(const unsigned char *parm, fixed32 hper[2], fixed32 *gain, fixed32 k[]);
+} lpc_variant;
+
+static const lpc_variant *find_variant(int framelen, int lpcbits);
+
+#include "openlpc_dequant.h"
+
+/* Inner loops of the analysis, with SIMD versions on x86 hosts:
+   dot64() is the sum of a[i] * b[i] in 64 bits,
+   mulq() is y[i] = fixmul32(x[i], h[i * hstep]) with hstep 1 or -1,
+   lattice() runs one sample of the synthesis lattice for n channels of
+   the multi-channel decoder, whose state is laid out by stage:
+   bp[m * stride + c], k[m * stride + c]. u[] is the excitation on input
+   and the output sample on return; k[] is stepped by kinc[] once used.
+   The SIMD versions give exactly the same results as the scalar ones. */
+
+static fixed64 dot64_scalar(const fixed32 *a, const fixed32 *b, int n)
+{
+    int i;
+    fixed64 temp = 0, temp2;
+
+    for (i=0; i < n; i++) {
+        temp2 = a[i];
+        temp += temp2 * b[i];
+    }
+    return temp;
+}
+
+static void mulq_scalar(const fixed32 *x, const fixed32 *h, int hstep, fixed32 *y, int n)
+{
+    int i;
+
+    for (i=0; i < n; i++)
+        y[i] = fixmul32(x[i], (fixed32)pgm_read_dword(&h[i * hstep]));
+}
+
+static void lattice_scalar(fixed32 *u, fixed32 *bp, fixed32 *k, const fixed32 *kinc, int stride, int n)
+{
+    int c, m;
+
+    for (c=0; c < n; c++) {
+        fixed32 uc = u[c];
+
+        for (m=LPC_FILTORDER; m >= 1; m--) {
+            fixed32 kj = k[m * stride + c];
+
+            uc -= fixmul32(kj, bp[(m - 1) * stride + c]);
+            bp[m * stride + c] = bp[(m - 1) * stride + c] + fixmul32(kj, uc);
+            k[m * stride + c] = kj + kinc[m * stride + c];
+        }
+        bp[c] = uc;
+        u[c] = uc;
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPENLPC_X86_KERNELS
+#include <immintrin.h>
 
-static fixed32 logmaxminper;
-static int sizeofparm;  /* computed by lpc_init */
+/* _mm_mul_epi32 only multiplies the even 32-bit lanes, the odd ones are
+   shifted down for a second multiply. The low 32 bits of a 64-bit product
+   shifted by PRECISION are the same with a logical shift. */
 
-static void auto_correl1(fixed32 *w, int n, fixed32 *r)
+__attribute__((target("sse4.1")))
+static __inline __m128i fixmul32_sse41(__m128i x, __m128i y)
 {
-    int i, k;
-    fixed64 temp, temp2;
+    __m128i even = _mm_srli_epi64(_mm_mul_epi32(x, y), PRECISION);
+    __m128i odd = _mm_srli_epi64(_mm_mul_epi32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32)), PRECISION);
 
-    for (k=0; k <= MAXPER; k++, n--) {
-        temp = 0;
-        for (i=0; i < n; i++) {
-            temp2 = w[i];
-            temp += temp2 * w[i+k];
+    return _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xcc);
+}
+
+/* four channels of lattice() */
+__attribute__((target("sse4.1")))
+static __inline void lattice4_sse41(fixed32 *u, fixed32 *bp, fixed32 *k, const fixed32 *kinc, int stride)
+{
+    __m128i uc = _mm_loadu_si128((const __m128i *)u);
+    int m;
+
+    for (m=LPC_FILTORDER; m >= 1; m--) {
+        __m128i kj = _mm_loadu_si128((const __m128i *)(k + m * stride));
+        __m128i prev = _mm_loadu_si128((const __m128i *)(bp + (m - 1) * stride));
+
+        uc = _mm_sub_epi32(uc, fixmul32_sse41(kj, prev));
+        _mm_storeu_si128((__m128i *)(bp + m * stride), _mm_add_epi32(prev, fixmul32_sse41(kj, uc)));
+        _mm_storeu_si128((__m128i *)(k + m * stride),
+                         _mm_add_epi32(kj, _mm_loadu_si128((const __m128i *)(kinc + m * stride))));
+    }
+    _mm_storeu_si128((__m128i *)bp, uc);
+    _mm_storeu_si128((__m128i *)u, uc);
+}
+
+__attribute__((target("sse4.1")))
+static fixed64 dot64_sse41(const fixed32 *a, const fixed32 *b, int n)
+{
+    int i;
+    __m128i acc = _mm_setzero_si128();
+    fixed64 lanes[2];
+
+    for (i=0; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(va, vb));
+        acc = _mm_add_epi64(acc, _mm_mul_epi32(_mm_srli_epi64(va, 32), _mm_srli_epi64(vb, 32)));
+    }
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + dot64_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void mulq_sse41(const fixed32 *x, const fixed32 *h, int hstep, fixed32 *y, int n)
+{
+    int i;
+
+    for (i=0; i + 4 <= n; i += 4) {
+        __m128i vx = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i vh;
+
+        if (hstep > 0) {
+            vh = _mm_loadu_si128((const __m128i *)(h + i));
+        } else {
+            vh = _mm_loadu_si128((const __m128i *)(h - i - 3));
+            vh = _mm_shuffle_epi32(vh, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+        _mm_storeu_si128((__m128i *)(y + i), fixmul32_sse41(vx, vh));
+    }
+    mulq_scalar(x + i, h + i * hstep, hstep, y + i, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void lattice_sse41(fixed32 *u, fixed32 *bp, fixed32 *k, const fixed32 *kinc, int stride, int n)
+{
+    int c;
+
+    for (c=0; c + 4 <= n; c += 4)
+        lattice4_sse41(u + c, bp + c, k + c, kinc + c, stride);
+    lattice_scalar(u + c, bp + c, k + c, kinc + c, stride, n - c);
+}
+
+__attribute__((target("avx2")))
+static __inline __m256i fixmul32_avx2(__m256i x, __m256i y)
+{
+    __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(x, y), PRECISION);
+    __m256i odd = _mm256_srli_epi64(_mm256_mul_epi32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32)), PRECISION);
+
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+}
+
+__attribute__((target("avx2")))
+static fixed64 dot64_avx2(const fixed32 *a, const fixed32 *b, int n)
+{
+    int i;
+    __m256i acc = _mm256_setzero_si256();
+    fixed64 lanes[4];
+
+    for (i=0; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(va, vb));
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_srli_epi64(va, 32), _mm256_srli_epi64(vb, 32)));
+    }
+    /* the tail stays in this function: calling the non-VEX SSE version with
+       the upper halves dirty costs more than it saves */
+    if (i + 4 <= n) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i lo = _mm_add_epi64(_mm_mul_epi32(va, vb),
+                                   _mm_mul_epi32(_mm_srli_epi64(va, 32), _mm_srli_epi64(vb, 32)));
+
+        acc = _mm256_add_epi64(acc, _mm256_zextsi128_si256(lo));
+        i += 4;
+    }
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dot64_scalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void mulq_avx2(const fixed32 *x, const fixed32 *h, int hstep, fixed32 *y, int n)
+{
+    int i;
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+
+    for (i=0; i + 8 <= n; i += 8) {
+        __m256i vx = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i vh;
+
+        if (hstep > 0) {
+            vh = _mm256_loadu_si256((const __m256i *)(h + i));
+        } else {
+            vh = _mm256_loadu_si256((const __m256i *)(h - i - 7));
+            vh = _mm256_permutevar8x32_epi32(vh, reverse);
+        }
+        _mm256_storeu_si256((__m256i *)(y + i), fixmul32_avx2(vx, vh));
+    }
+    mulq_scalar(x + i, h + i * hstep, hstep, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void lattice_avx2(fixed32 *u, fixed32 *bp, fixed32 *k, const fixed32 *kinc, int stride, int n)
+{
+    int c, m;
+
+    /* one 256-bit pass per sample between long stretches of scalar
+       excitation is slower than 128-bit ones: only go wide when there
+       are a few vectors of channels */
+    for (c=0; n >= 32 && c + 8 <= n; c += 8) {
+        __m256i uc = _mm256_loadu_si256((const __m256i *)(u + c));
+
+        for (m=LPC_FILTORDER; m >= 1; m--) {
+            __m256i kj = _mm256_loadu_si256((const __m256i *)(k + m * stride + c));
+            __m256i prev = _mm256_loadu_si256((const __m256i *)(bp + (m - 1) * stride + c));
+
+            uc = _mm256_sub_epi32(uc, fixmul32_avx2(kj, prev));
+            _mm256_storeu_si256((__m256i *)(bp + m * stride + c), _mm256_add_epi32(prev, fixmul32_avx2(kj, uc)));
+            _mm256_storeu_si256((__m256i *)(k + m * stride + c),
+                                _mm256_add_epi32(kj, _mm256_loadu_si256((const __m256i *)(kinc + m * stride + c))));
         }
-        r[k] = (fixed32)(temp >> PRECISION);
+        _mm256_storeu_si256((__m256i *)(bp + c), uc);
+        _mm256_storeu_si256((__m256i *)(u + c), uc);
+    }
+    /* inlined here, so the 4-wide passes are VEX encoded too */
+    for (; c + 4 <= n; c += 4)
+        lattice4_sse41(u + c, bp + c, k + c, kinc + c, stride);
+    lattice_scalar(u + c, bp + c, k + c, kinc + c, stride, n - c);
+}
+
+typedef struct lpc_kernels {
+    fixed64 (*dot64)(const fixed32 *a, const fixed32 *b, int n);
+    void    (*mulq)(const fixed32 *x, const fixed32 *h, int hstep, fixed32 *y, int n);
+    void    (*lattice)(fixed32 *u, fixed32 *bp, fixed32 *k, const fixed32 *kinc, int stride, int n);
+} lpc_kernels;
+
+static const lpc_kernels kernels[] = {
+    { dot64_scalar, mulq_scalar, lattice_scalar },  /* OPENLPC_KERNELS_SCALAR */
+    { dot64_sse41,  mulq_sse41,  lattice_sse41 },   /* OPENLPC_KERNELS_SSE41 */
+    { dot64_avx2,   mulq_avx2,   lattice_avx2 },    /* OPENLPC_KERNELS_AVX2 */
+};
+
+static int best_kernels(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return OPENLPC_KERNELS_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return OPENLPC_KERNELS_SSE41;
+    return OPENLPC_KERNELS_SCALAR;
+}
+
+static const int kernels_supported = best_kernels();
+static int kernels_used = kernels_supported;
+
+#define dot64(a, b, n)              kernels[kernels_used].dot64(a, b, n)
+#define mulq(x, h, hstep, y, n)     kernels[kernels_used].mulq(x, h, hstep, y, n)
+#define lattice(u, bp, k, kinc, stride, n) kernels[kernels_used].lattice(u, bp, k, kinc, stride, n)
+#else
+static const int kernels_supported = OPENLPC_KERNELS_SCALAR;
+static int kernels_used = OPENLPC_KERNELS_SCALAR;
+
+#define dot64(a, b, n)              dot64_scalar(a, b, n)
+#define mulq(x, h, hstep, y, n)     mulq_scalar(x, h, hstep, y, n)
+#define lattice(u, bp, k, kinc, stride, n) lattice_scalar(u, bp, k, kinc, stride, n)
+#endif
+
+int openlpc_set_kernels(int backend)
+{
+    if (backend < OPENLPC_KERNELS_SCALAR || backend > kernels_supported)
+        return -1;
+    kernels_used = backend;
+    return 0;
+}
+
+int openlpc_get_kernels(void)
+{
+    return kernels_used;
+}
+
+/* sum of d[i] * d[i+k] for i in [from, to) */
+static fixed64 lag_product(const fixed32 *d, int from, int to, int k)
+{
+    return to > from ? dot64(d + from, d + from + k, to - from) : 0;
+}
+
+static void auto_correl1(const fixed32 *w, int n, fixed32 *r)
+{
+    int k;
+
+    for (k=0; k < PITCH_LAGS; k++)
+        r[k] = (fixed32)(lag_product(w, 0, n - k, k) >> PRECISION);
+}
+
+#if PITCH_ENGINE == PITCH_SHARED
+/* autocorrelations of d[0..n) into r1[] and of d[h..h+n) into r2[]; the
+   products that fall in the overlap d[h..n) are only computed once */
+static void auto_correl_shared(const fixed32 *d, int n, int h, fixed32 *r1, fixed32 *r2)
+{
+    int k;
+
+    for (k=0; k < PITCH_LAGS; k++) {
+        int m = n - k;
+        fixed64 a = lag_product(d, 0, m < h ? m : h, k);
+        fixed64 b = lag_product(d, h, m, k);
+        fixed64 c = lag_product(d, m > h ? m : h, h + m, k);
+
+        r1[k] = (fixed32)((a + b) >> PRECISION);
+        r2[k] = (fixed32)((b + c) >> PRECISION);
     }
 }
+#endif
 
-static void auto_correl2(fixed32 *w, int n, fixed32 *r)
+#if PITCH_ENGINE == PITCH_INCREMENTAL
+/* d[] is three blocks of h samples, b0 b1 b2; the two pitch regions are
+   b0 b1 and b1 b2. Each region's autocorrelation is the sum of the ones of
+   its blocks plus the cross products between them. b0 is the b2 of the
+   previous frame, so its part comes from acc[], which gets b2's for the
+   next frame. */
+static void auto_correl_incremental(const fixed32 *d, int h, fixed64 *acc, fixed32 *r1, fixed32 *r2)
 {
-    int i, k;
-    fixed64 temp, temp2;
+    int k;
+
+    for (k=0; k < PITCH_LAGS; k++) {
+        int m = h - k;
+        fixed64 a1 = lag_product(d, h, h + m, k);
+        fixed64 a2 = lag_product(d, 2 * h, 2 * h + m, k);
+        fixed64 c01 = lag_product(d, m > 0 ? m : 0, m + h < h ? m + h : h, k);
+        fixed64 c12 = lag_product(d, m > 0 ? h + m : h, m + h < h ? m + 2 * h : 2 * h, k);
+
+        r1[k] = (fixed32)((acc[k] + a1 + c01) >> PRECISION);
+        r2[k] = (fixed32)((a1 + a2 + c12) >> PRECISION);
+        acc[k] = a2;
+    }
+}
+#endif
+
+/* The LPC autocorrelation of the windowed frame. ANALYSIS_MULTIPASS
+   windows the whole ring into w[] and then takes each lag over it;
+   ANALYSIS_FUSED windows CORREL_BLOCK samples at a time into a buffer on
+   the stack and adds their products right away, with the last
+   LPC_FILTORDER windowed samples carried over from the previous block,
+   so w[] is not allocated and each sample is read once while it is in
+   cache. The sums are the same, so are the results. The SIMD kernels
+   do better on whole frames, so x86 hosts keep the multi-pass analysis. */
+#define ANALYSIS_MULTIPASS  0
+#define ANALYSIS_FUSED      1
+
+#ifndef ANALYSIS_MODE
+#ifdef OPENLPC_X86_KERNELS
+#define ANALYSIS_MODE   ANALYSIS_MULTIPASS
+#else
+#define ANALYSIS_MODE   ANALYSIS_FUSED
+#endif
+#endif
+
+#define CORREL_BLOCK    64
 
-    for (k=0; k <= LPC_FILTORDER; k++, n--) {
-        temp = 0;
-        for (i=0; i < n; i++) {
-            temp2 = w[i];
-            temp += temp2 * w[i+k];
+#if ANALYSIS_MODE == ANALYSIS_FUSED
+/* windows the winlen samples of the ring from s[start] by the symmetric
+   window h[] and returns the first LPC_FILTORDER+1 lags in r[] */
+static void window_correl(const fixed32 *s, int buflen, int start, const fixed32 *h, int winlen, fixed32 *r)
+{
+    int i, j, k, m, n, end, half, wrap;
+    fixed32 x[LPC_FILTORDER + CORREL_BLOCK];
+    fixed64 acc[LPC_FILTORDER+1];
+
+    for (k=0; k < LPC_FILTORDER; k++)
+        x[k] = 0;
+    for (k=0; k <= LPC_FILTORDER; k++)
+        acc[k] = 0;
+
+    half = (winlen + 1) / 2;
+    wrap = buflen - start;
+    for (i=0; i < winlen; i = end) {
+        end = i + CORREL_BLOCK < winlen ? i + CORREL_BLOCK : winlen;
+
+        /* window the block after the history, in runs that are contiguous
+           in the ring and go one way through the symmetric window */
+        for (m=i; m < end; m += n) {
+            j = m < wrap ? start + m : m - wrap;
+            n = end - m;
+            if (m < wrap && wrap - m < n)
+                n = wrap - m;
+            if (m < half && half - m < n)
+                n = half - m;
+            if (m < half)
+                mulq(s + j, h + m, 1, x + LPC_FILTORDER + m - i, n);
+            else
+                mulq(s + j, h + winlen - 1 - m, -1, x + LPC_FILTORDER + m - i, n);
         }
-        r[k] = (fixed32)(temp >> PRECISION);
+
+        /* products of each sample of the block with the ones k before */
+        for (k=0; k <= LPC_FILTORDER; k++)
+            acc[k] += dot64(x + LPC_FILTORDER, x + LPC_FILTORDER - k, end - i);
+
+        /* the last LPC_FILTORDER samples are the history of the next block */
+        for (k=0; k < LPC_FILTORDER; k++)
+            x[k] = x[end - i + k];
     }
+    for (k=0; k <= LPC_FILTORDER; k++)
+        r[k] = (fixed32)(acc[k] >> PRECISION);
+}
+#else
+static void auto_correl2(const fixed32 *w, int n, fixed32 *r)
+{
+    int k;
+
+    for (k=0; k <= LPC_FILTORDER; k++, n--)
+        r[k] = (fixed32)(dot64(w, w + k, n) >> PRECISION);
 }
+#endif
 
 static void durbin(fixed32 r[], int p, fixed32 k[], fixed32 *g)
 {
@@ -486,20 +1046,68 @@ static void durbin(fixed32 r[], int p, fixed32 k[], fixed32 *g)
     *g = fixsqrt32(e);
 }
 
-static void calc_pitch(fixed32 w[], int len, fixed32 *per)
+/* decimates len samples of the Q15 ring w[] of size samples, from w[start] */
+static int decimate(const short w[], int size, int start, int len, fixed32 *d)
+{
+    int i, j;
+
+    for (i=0, j=0; i < len; i+=DOWN) {
+        d[j++] = (fixed32)w[start] << (PRECISION - 15);
+        start += DOWN;
+        if (start >= size)
+            start -= size;
+    }
+    return j;
+}
+
+/* autocorrelations of the decimated y[] over the two pitch regions; in
+   low delay mode only over the second one, the first one was the second
+   one of the previous frame */
+static void pitch_correl(openlpc_encoder_state *st, fixed32 *r1, fixed32 *r2)
+{
+    fixed32 d[MAXWINDOW / DOWN];
+    int n = st->pitchlen / DOWN;
+    int half = st->buflen - st->pitchlen;
+
+    if (st->low_delay) {
+        half += st->pos;
+        if (half >= st->buflen)
+            half -= st->buflen;
+        decimate(st->y, st->buflen, half, st->pitchlen, d);
+        auto_correl1(d, n, r2);
+        return;
+    }
+#if PITCH_ENGINE == PITCH_INCREMENTAL
+    if (st->framelen % (2 * DOWN) == 0) {
+        decimate(st->y, st->buflen, st->pos, st->buflen, d);
+        auto_correl_incremental(d, n / 2, st->pitch_auto, r1, r2);
+        return;
+    }
+#elif PITCH_ENGINE == PITCH_SHARED
+    if (half % DOWN == 0) {
+        decimate(st->y, st->buflen, st->pos, st->buflen, d);
+        auto_correl_shared(d, n, half / DOWN, r1, r2);
+        return;
+    }
+#endif
+    /* the second region is not on the decimation grid of the first one */
+    half += st->pos;
+    if (half >= st->buflen)
+        half -= st->buflen;
+    decimate(st->y, st->buflen, st->pos, st->pitchlen, d);
+    auto_correl1(d, n, r1);
+    decimate(st->y, st->buflen, half, st->pitchlen, d);
+    auto_correl1(d, n, r2);
+}
+
+static void pick_pitch(const fixed32 r[], fixed32 *per)
 {
-    int i, j, rpos;
-    fixed32 d[MAXWINDOW / DOWN], r[MAXPER + 1], rmax;
+    int i, rpos;
+    fixed32 rmax;
     fixed32 rval, rm, rp;
     fixed32 x, y;
     fixed32 vthresh;
 
-    /* decimation */
-    for (i=0, j=0; i < len; i+=DOWN)
-        d[j++] = w[i];
-
-    auto_correl1(d, len / DOWN, r);
-
     /* find peak between MINPER and MAXPER */
     x = itofix32(1);
     rpos = 0;
@@ -516,10 +1124,9 @@ static void calc_pitch(fixed32 w[], int len, fixed32 *per)
     }
 
     /* consider adjacent values */
-    rm = r[rpos-1];
-    rp = r[rpos+1];
-
     if(rpos > 0) {
+        rm = r[rpos-1];
+        rp = r[rpos+1];
         x = fixdiv32(((rpos-1) * rm + rpos * r[rpos] + (rpos+1) * rp), (rm+r[rpos]+rp));
     }
     /* normalize, so that 0. < rval < 1. */
@@ -550,60 +1157,185 @@ openlpc_encoder_state *create_openlpc_encoder_state(void)
     openlpc_encoder_state *state;
 
     state = (openlpc_encoder_state *)malloc(sizeof(openlpc_encoder_state));
+    if(state != NULL)
+    {
+        state->framelen = 0;
+        state->mem = NULL;
+        state->memsize = 0;
+        state->encode_frames = NULL;
+        state->push = NULL;
+    }
 
     return state;
 }
 
-
-void init_openlpc_encoder_state(openlpc_encoder_state *st, int framelen)
+/* On failure (frame too long, unknown lpcbits, out of memory) framelen is
+   left at 0 and openlpc_encode() produces nothing. */
+static void init_encoder(openlpc_encoder_state *st, int framelen, int lpcbits, int low_delay)
 {
-    int i, j;
-
-    st->framelen = framelen;
-    memset(st->y, 0, sizeof(st->y));
-    st->buflen = framelen * 3 / 2;
-    /*  (st->buflen > MAXWINDOW) return -1;*/
+    int i, buflen, winlen, size, hoff;
+    const fixed32 *h;
+    const lpc_variant *v;
+
+    st->framelen = 0;
+    st->encode_frames = NULL;
+    st->push = NULL;
+    buflen = low_delay ? framelen * 3 : framelen * 3 / 2;
+    winlen = low_delay ? framelen * 2 : buflen;
+    /* low delay runs the generic code, which reads the lengths from st */
+    v = find_variant(low_delay ? 0 : framelen, lpcbits);
+    if (winlen < 2 || buflen > MAXWINDOW || v == NULL)
+        return;
+
+    switch (winlen) {
+    case 240: h = hamming240; break;
+    case 375: h = hamming375; break;
+    case 480: h = hamming480; break;
+    default:  h = NULL; break;
+    }
 
-    for(i=0, j=0; i<sizeof(parambits)/sizeof(parambits[0]); i++) {
-        j += parambits[i];
+    /* s[] and w[], then y[], then h[] if there is no shared table; the
+       fused analysis has no w[] */
+    size = buflen * (sizeof(fixed32) + sizeof(short));
+#if ANALYSIS_MODE == ANALYSIS_MULTIPASS
+    size += winlen * sizeof(fixed32);
+#endif
+    hoff = size = (size + 3) & ~3;
+    if (h == NULL)
+        size += (winlen + 1) / 2 * sizeof(fixed32);
+
+    if (size != st->memsize) {
+        free(st->mem);
+        st->mem = malloc(size);
+        st->memsize = st->mem == NULL ? 0 : size;
+        if (st->mem == NULL)
+            return;
     }
-    sizeofparm = (j + 7) / 8 + 2;
-    for (i = 0; i < st->buflen; i++) {
-        st->s[i] = 0;
-        /* this is only calculated once, but used each frame, */
-        /* so we will use floating point for accuracy */
-        st->h[i] = ftofix32(WSCALE*(0.54 - 0.46 * cos(2 * M_PI * i / (st->buflen-1.0))));
+
+    st->s = (fixed32 *)st->mem;
+    st->w = st->s + buflen;
+#if ANALYSIS_MODE == ANALYSIS_MULTIPASS
+    st->y = (short *)(st->w + winlen);
+#else
+    st->y = (short *)st->w;
+#endif
+    if (h == NULL) {
+        fixed32 *hbuf = (fixed32 *)((char *)st->mem + hoff);
+
+        for (i = 0; i < (winlen + 1) / 2; i++) {
+            /* this is only calculated once, but used each frame, */
+            /* so we will use floating point for accuracy */
+            hbuf[i] = ftofix32(WSCALE*(0.54 - 0.46 * cos(2 * M_PI * i / (winlen-1.0))));
+        }
+        h = hbuf;
     }
+    st->h = h;
+
+    st->framelen = framelen;
+    st->buflen = buflen;
+    st->winlen = winlen;
+    st->pitchlen = low_delay ? framelen * 2 : framelen;
+    st->low_delay = low_delay;
+    st->pos = 0;
+    st->fill = 0;
+    memset(st->s, 0, buflen * sizeof(st->s[0]));
+    memset(st->y, 0, buflen * sizeof(st->y[0]));
+    memset(st->r_last, 0, sizeof(st->r_last));
+    st->per_track = 0;
+
+    st->encode_frames = v->encode_frames;
+    st->push = v->push;
     /* init the filters */
     st->xv1[0] = st->xv1[1] = st->xv1[2] = st->yv1[0] = st->yv1[1] = st->yv1[2] = 0;
     st->xv2[0] = st->xv2[1] = st->yv2[0] = st->yv2[1] = 0;
     st->xv3[0] = st->yv3[0] = st->yv3[1] = st->yv3[2] = 0;
     st->xv4[0] = st->xv4[1] = st->yv4[0] = st->yv4[1] = 0;
 
-    logmaxminper = fixlog32(fixdiv32(itofix32(MAXPER), itofix32(MINPER)));
+#if PITCH_ENGINE == PITCH_INCREMENTAL
+    memset(st->pitch_auto, 0, sizeof(st->pitch_auto));
+#endif
+
+    st->logmaxminper = fixlog32(fixdiv32(itofix32(MAXPER), itofix32(MINPER)));
+
+    st->vad_floor = -1;     /* the first frame sets it */
+    st->vad_hang = 0;
+    st->dtx_count = 0;
+}
+
+void init_openlpc_encoder_state_bits(openlpc_encoder_state *st, int framelen, int lpcbits)
+{
+    init_encoder(st, framelen, lpcbits, 0);
+}
+
+void init_openlpc_encoder_state_low_delay(openlpc_encoder_state *st, int framelen, int lpcbits)
+{
+    init_encoder(st, framelen, lpcbits, 1);
+}
+
+void init_openlpc_encoder_state(openlpc_encoder_state *st, int framelen)
+{
+    init_openlpc_encoder_state_bits(st, framelen, OPENLPC_BITS_38);
+}
+
+int openlpc_encoder_state_size(const openlpc_encoder_state *st)
+{
+    return sizeof(*st) + st->memsize;
 }
 
 void destroy_openlpc_encoder_state(openlpc_encoder_state *st)
 {
     if(st != NULL)
     {
+        free(st->mem);
         free(st);
         st = NULL;
     }
 }
 
+/* A frame is speech if it is voiced or has more than VAD_RATIO times the
+   energy of the background noise. The noise estimate drops to any quieter
+   frame at once and creeps up by 1/128 per frame otherwise. */
+static int vad_send(const unsigned char *parm, openlpc_encoder_state *st)
+{
+    fixed32 energy = st->r[0];
+
+    if (energy < st->vad_floor || st->vad_floor < 0)
+        st->vad_floor = energy;
+    else
+        st->vad_floor += (st->vad_floor >> 7) + 1;
+    if (st->vad_floor < VAD_MIN_FLOOR)
+        st->vad_floor = VAD_MIN_FLOOR;
+
+    if ((parm[1] & 0x3) != 0 || energy / VAD_RATIO > st->vad_floor) {
+        st->vad_hang = (VAD_HANGOVER + st->framelen - 1) / st->framelen;
+        st->dtx_count = 0;
+        return 1;
+    }
+    if (st->vad_hang > 0) {
+        st->vad_hang--;
+        return 1;
+    }
+
+    /* silence, and unvoiced: the frame itself describes the noise */
+    return st->dtx_count++ % OPENLPC_SID_FRAMES == 0;
+}
+
 /* LPC Analysis (compression) */
 
-int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state *st)
+/* Runs n samples of buf[] through the prefilters into s[] and y[], from
+   ring index start on. The filter memories stay in locals for the run. */
+template <class cfg>
+static void prefilter(const short *buf, int n, int start, openlpc_encoder_state *st)
 {
-    int i, j;
-    fixed32 per, gain, k[LPC_FILTORDER+1];
-    fixed32 per1, per2;
+    int i, j, buflen;
     fixed32 xv10, xv11, xv12, yv10, yv11, yv12, xv30, yv30, yv31, yv32;
 #ifdef PREEMPH
     fixed32 xv20, xv21, yv20, yv21, xv40, xv41, yv40, yv41;
 #endif
 
+    /* the stores to s[] could alias the struct, keep the size in a local */
+    buflen = cfg::framelen ? cfg::framelen * 3 / 2 : st->buflen;
+
     xv10 = st->xv1[0];
     xv11 = st->xv1[1];
     xv12 = st->xv1[2];
@@ -615,9 +1347,21 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
     yv31 = st->yv3[1];
     yv32 = st->yv3[2];
 
+#ifdef PREEMPH
+    xv20 = st->xv2[0];
+    xv21 = st->xv2[1];
+    yv20 = st->yv2[0];
+    yv21 = st->yv2[1];
+    xv40 = st->xv4[0];
+    xv41 = st->xv4[1];
+    yv40 = st->yv4[0];
+    yv41 = st->yv4[1];
+#endif
+
+    PROF_BEGIN();
 
     /* convert short data in buf[] to signed lin. data in s[] and prefilter */
-    for (i=0, j=st->buflen - st->framelen; i < st->framelen; i++, j++) {
+    for (i=0, j=start; i < n; i++) {
 
         /* special handling here for the intitial conversion */
         fixed32 u = (fixed32)(buf[i] << (PRECISION - 15));
@@ -628,106 +1372,100 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
 
         xv10 = xv11;
         xv11 = xv12;
-#ifdef FAST_FILTERS
-        xv12 = ((u * 15) >> 4) + (u >> 7) + ((u * 11) >> 14); /* /GAIN */
-        yv10 = yv11;
-        yv11 = yv12;
-        yv12 = (fixed32)((xv10 + xv12) - (xv11 + xv11)
-            - ((yv10 * 7) >> 3) - ((yv10 * 5) >> 8)
-            + ((yv11 * 15) >> 3) + (yv11 >> 6) );
-#else
-        xv12 = fixmul32(u, ftofix32(0.94597831)); /* /GAIN */
-        yv10 = yv11;
-        yv11 = yv12;
-        yv12 = (fixed32)((xv10 + xv12) - (xv11 + xv11)
-            + fixmul32(ftofix32(-0.8948742499), yv10) + fixmul32(ftofix32(1.8890389823), yv11));
-#endif
+        if (cfg::fast_filters) {
+            xv12 = ((u * 15) >> 4) + (u >> 7) + ((u * 11) >> 14); /* /GAIN */
+            yv10 = yv11;
+            yv11 = yv12;
+            yv12 = (fixed32)((xv10 + xv12) - (xv11 + xv11)
+                - ((yv10 * 7) >> 3) - ((yv10 * 5) >> 8)
+                + ((yv11 * 15) >> 3) + (yv11 >> 6) );
+        } else {
+            xv12 = fixmul32(u, ftofix32(0.94597831)); /* /GAIN */
+            yv10 = yv11;
+            yv11 = yv12;
+            yv12 = (fixed32)((xv10 + xv12) - (xv11 + xv11)
+                + fixmul32(ftofix32(-0.8948742499), yv10) + fixmul32(ftofix32(1.8890389823), yv11));
+        }
         u = st->s[j] = yv12; /* also affects input of next stage, to the LPC filter synth */
 
         /* low-pass filter s[] -> y[] before computing pitch */
         /* second-order Butterworth low-pass filter, corner at 300 Hz */
         /* Digital filter designed by mkfilter/mkshape/gencode   A.J. Fisher
         MKFILTER.EXE -Bu -Lp -o 2 -a 0.0375 -l -z */
-#ifdef FAST_FILTERS
-        xv30 = ((u * 3) >> 6) + (u >> 13); /* GAIN */
-        yv30 = yv31;
-        yv31 = yv32;
-        yv32 = xv30 - ((yv30 * 23) >> 5) + (yv30 >> 9)
-            + ((yv31 * 107) >> 6) - (yv31 >> 9);
-#else
-        xv30 = fixmul32(u, ftofix32(0.04699658)); /* GAIN */
-        yv30 = yv31;
-        yv31 = yv32;
-        yv32 = xv30 + fixmul32(ftofix32(-0.7166152306), yv30) + fixmul32(ftofix32(1.6696186545), yv31);
-#endif
-        st->y[j] = yv32;
-    }
-//#if 0//raul
-    st->xv1[0] = xv10;
-    st->xv1[1] = xv11;
-    st->xv1[2] = xv12;
-    st->yv1[0] = yv10;
-    st->yv1[1] = yv11;
-    st->yv1[2] = yv12;
-    st->xv3[0] = xv30;
-    st->yv3[0] = yv30;
-    st->yv3[1] = yv31;
-    st->yv3[2] = yv32;
+        if (cfg::fast_filters) {
+            xv30 = ((u * 3) >> 6) + (u >> 13); /* GAIN */
+            yv30 = yv31;
+            yv31 = yv32;
+            yv32 = xv30 - ((yv30 * 23) >> 5) + (yv30 >> 9)
+                + ((yv31 * 107) >> 6) - (yv31 >> 9);
+        } else {
+            xv30 = fixmul32(u, ftofix32(0.04699658)); /* GAIN */
+            yv30 = yv31;
+            yv31 = yv32;
+            yv32 = xv30 + fixmul32(ftofix32(-0.7166152306), yv30) + fixmul32(ftofix32(1.6696186545), yv31);
+        }
+        /* the pitch detector only needs Q15 */
+        u = yv32 >> (PRECISION - 15);
+        st->y[j] = (short)(u > 32767 ? 32767 : (u < -32768 ? -32768 : u));
 
 #ifdef PREEMPH
-    /* operate optional preemphasis s[] -> s[] on the newly arrived frame */
-    xv20 = st->xv2[0];
-    xv21 = st->xv2[1];
-    yv20 = st->yv2[0];
-    yv21 = st->yv2[1];
-    xv40 = st->xv4[0];
-    xv41 = st->xv4[1];
-    yv40 = st->yv4[0];
-    yv41 = st->yv4[1];
-
-
-    for (j=st->buflen - st->framelen; j < st->buflen; j++) {
-        fixed32 u = st->s[j];
+        /* operate optional preemphasis on s[] in the same pass */
+        u = yv12;
 
         /* handcoded filter: 1 zero at 640 Hz, 1 pole at 3200 */
 #define TAU (FS / 3200.f)
 #define RHO (0.1f)
         xv20 = xv21;    /* e(n-1) */
-#ifdef FAST_FILTERS
-        xv21 = ((u * 3) >> 1) +((u * 43) >> 9);     /* e(n) , add 4 dB to compensate attenuation */
-        yv20 = yv21;
-        yv21 = ((yv20 * 11) >> 4) + ((yv20 * 7) >> 10)   /* u(n) */
-            + ((xv21 * 23) >> 5) + ((xv21 * 7) >> 11)
-            - ((xv20 * 11) >> 4) - ((xv20 * 7) >> 10);
-#else
-        xv21 = fixmul32(u, ftofix32(1.584));        /* e(n) , add 4 dB to compensate attenuation */
-        yv20 = yv21;
-        yv21 = fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), yv20)      /* u(n) */
-            + fixmul32(ftofix32((RHO+TAU)/(1.0f+RHO+TAU)), xv21)
-            - fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), xv20);
-#endif
+        if (cfg::fast_filters) {
+            xv21 = ((u * 3) >> 1) +((u * 43) >> 9);     /* e(n) , add 4 dB to compensate attenuation */
+            yv20 = yv21;
+            yv21 = ((yv20 * 11) >> 4) + ((yv20 * 7) >> 10)   /* u(n) */
+                + ((xv21 * 23) >> 5) + ((xv21 * 7) >> 11)
+                - ((xv20 * 11) >> 4) - ((xv20 * 7) >> 10);
+        } else {
+            xv21 = fixmul32(u, ftofix32(1.584));        /* e(n) , add 4 dB to compensate attenuation */
+            yv20 = yv21;
+            yv21 = fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), yv20)      /* u(n) */
+                + fixmul32(ftofix32((RHO+TAU)/(1.0f+RHO+TAU)), xv21)
+                - fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), xv20);
+        }
         u = yv21;
 
         /* cascaded copy of handcoded filter: 1 zero at 640 Hz, 1 pole at 3200 */
         xv40 = xv41;
-#ifdef FAST_FILTERS
-        xv41 = ((u * 3) >> 1) +((u * 43) >> 9);     /* e(n) , add 4 dB to compensate attenuation */
-        yv40 = yv41;
-        yv41 = ((yv40 * 11) >> 4) + ((yv40 * 7) >> 10)   /* u(n) */
-            + ((xv41 * 23) >> 5) + ((xv41 * 7) >> 11)
-            - ((xv40 * 11) >> 4) - ((xv40 * 7) >> 10);
-#else
-        xv41 = fixmul32(u, ftofix32(1.584));
-        yv40 = yv41;
-        yv41 = fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), yv40)
-            + fixmul32(ftofix32((RHO+TAU)/(1.0f+RHO+TAU)), xv41)
-            - fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), xv40);
-#endif
+        if (cfg::fast_filters) {
+            xv41 = ((u * 3) >> 1) +((u * 43) >> 9);     /* e(n) , add 4 dB to compensate attenuation */
+            yv40 = yv41;
+            yv41 = ((yv40 * 11) >> 4) + ((yv40 * 7) >> 10)   /* u(n) */
+                + ((xv41 * 23) >> 5) + ((xv41 * 7) >> 11)
+                - ((xv40 * 11) >> 4) - ((xv40 * 7) >> 10);
+        } else {
+            xv41 = fixmul32(u, ftofix32(1.584));
+            yv40 = yv41;
+            yv41 = fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), yv40)
+                + fixmul32(ftofix32((RHO+TAU)/(1.0f+RHO+TAU)), xv41)
+                - fixmul32(ftofix32(TAU/(1.0f+RHO+TAU)), xv40);
+        }
         u = yv41;
 
         st->s[j] = u;
+#endif
+        if (++j == buflen)
+            j = 0;
     }
+    PROF_MARK(PROF_PREFILTER);
 
+    st->xv1[0] = xv10;
+    st->xv1[1] = xv11;
+    st->xv1[2] = xv12;
+    st->yv1[0] = yv10;
+    st->yv1[1] = yv11;
+    st->yv1[2] = yv12;
+    st->xv3[0] = xv30;
+    st->yv3[0] = yv30;
+    st->yv3[1] = yv31;
+    st->yv3[2] = yv32;
+#ifdef PREEMPH
     st->xv2[0] = xv20;
     st->xv2[1] = xv21;
     st->yv2[0] = yv20;
@@ -737,19 +1475,87 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
     st->yv4[0] = yv40;
     st->yv4[1] = yv41;
 #endif
+}
 
-    /* operate windowing s[] -> w[] */
-
-    for (i=0; i < st->buflen; i++)
-        st->w[i] = fixmul32(st->s[i], st->h[i]);
+/* Analysis of the frame that has just filled the framelen oldest samples
+   of the ring, into parm[] */
+template <class cfg>
+static void analyse(unsigned char *parm, openlpc_encoder_state *st)
+{
+    int i, j, start;
+#if ANALYSIS_MODE == ANALYSIS_MULTIPASS
+    int n, half, wrap;
+#endif
+    int flen, buflen, winlen;
+    fixed32 per, gain, k[LPC_FILTORDER+1];
+    fixed32 per1, per2, r1[PITCH_LAGS], r2[PITCH_LAGS];
+
+    flen = cfg::framelen ? cfg::framelen : st->framelen;
+    buflen = cfg::framelen ? cfg::framelen * 3 / 2 : st->buflen;
+    winlen = cfg::framelen ? buflen : st->winlen;
+
+    PROF_BEGIN();
+
+    /* the new frame took the place of the oldest samples */
+    st->pos += flen;
+    if (st->pos >= buflen)
+        st->pos -= buflen;
+
+    start = st->pos + buflen - winlen;
+    if (start >= buflen)
+        start -= buflen;
+#if ANALYSIS_MODE == ANALYSIS_FUSED
+    /* window the newest winlen samples and compute the autocorrelation
+       (first 11 values) in the same pass */
+    window_correl(st->s, buflen, start, st->h, winlen, st->r);
+#else
+    /* operate windowing of the newest winlen samples s[] -> w[], in runs
+       that are contiguous in the ring and go one way through the
+       symmetric window */
+    half = (winlen + 1) / 2;
+    wrap = buflen - start;
+    for (i=0; i < winlen; i += n) {
+        j = i < wrap ? start + i : i - wrap;
+        n = winlen - i;
+        if (i < wrap && wrap - i < n)
+            n = wrap - i;
+        if (i < half && half - i < n)
+            n = half - i;
+        if (i < half)
+            mulq(st->s + j, st->h + i, 1, st->w + i, n);
+        else
+            mulq(st->s + j, st->h + winlen - 1 - i, -1, st->w + i, n);
+    }
+    PROF_MARK(PROF_WINDOW);
 
     /* compute LPC coeff. from autocorrelation (first 11 values) of windowed data */
-    auto_correl2(st->w, st->buflen, st->r);
+    auto_correl2(st->w, winlen, st->r);
+#endif
+    if (!cfg::framelen && st->low_delay) {
+        /* the window of the previous frame ends one frame earlier: the
+           two span 3 frames, like the standard window, and are scaled
+           to its energy, which the decoder's gainadj expects */
+        for (i=0; i <= LPC_FILTORDER; i++) {
+            fixed32 r = st->r[i];
+
+            st->r[i] = (fixed32)(((fixed64)r + st->r_last[i]) * 3 >> 3);
+            st->r_last[i] = r;
+        }
+    }
+    PROF_MARK(PROF_AUTOCORR);
     durbin(st->r, LPC_FILTORDER, k, &gain);
+    PROF_MARK(PROF_DURBIN);
 
     /* calculate pitch */
-    calc_pitch(st->y, st->framelen, &per1);                 /* first 2/3 of buffer */
-    calc_pitch(st->y + st->buflen - st->framelen, st->framelen, &per2); /* last 2/3 of buffer */
+    pitch_correl(st, r1, r2);
+    PROF_MARK(PROF_PITCH_CORREL);
+    if (!cfg::framelen && st->low_delay)
+        per1 = st->per_track;
+    else
+        pick_pitch(r1, &per1);  /* first 2/3 of buffer */
+    pick_pitch(r2, &per2);      /* last 2/3 of buffer */
+    st->per_track = per2;
+    PROF_MARK(PROF_PITCH_PICK);
     if(per1 > 0 && per2 > 0)
         per = (per1+per2) / 2;
     else if(per1 > 0)
@@ -760,7 +1566,7 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
         per = 0;
 
     /* logarithmic q.: 0 = MINPER, 256 = MAXPER */
-    parm[0] = (unsigned char)(per == 0? 0 : (unsigned char)fixtoi32(fixdiv32(fixlog32(fixdiv32(per, itofix32(REAL_MINPER))), logmaxminper) * 256));
+    parm[0] = (unsigned char)(per == 0? 0 : (unsigned char)fixtoi32(fixdiv32(fixlog32(fixdiv32(per, itofix32(REAL_MINPER))), st->logmaxminper) * 256));
 
 #ifdef LINEAR_G_Q
     i = fixtoi32(gain * 128);
@@ -779,19 +1585,17 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
     if(per2 > 0)
         parm[1] |= 2;
 
-    for(j=2; j < sizeofparm; j++)
+    for(j=2; j < cfg::layout::size; j++)
         parm[j] = 0;
 
     for (i=0; i < LPC_FILTORDER; i++) {
-        int bitamount = parambits[i];
-        int bitc8 = 8-bitamount;
+        const lpc_field *f = &cfg::layout::fields[i];
+        int bitc8 = f->bitc8;
         int q = (1 << bitc8);  /* quantum: 1, 2, 4... */
         fixed32 u = k[i+1];
         int iu;
 
-#ifdef ARCSIN_Q
-        if(i < 2) u = fixmul32(fixasin32(u), ftofix32(2.f/M_PI));
-#endif
+        if(cfg::arcsin_q && i < 2) u = fixmul32(fixasin32(u), ftofix32(2.f/M_PI));
         u *= 127;
         if(u < 0)
             u += ftofix32(0.6) * q;
@@ -799,18 +1603,90 @@ int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state
             u += ftofix32(0.4) * q; /* highly empirical! */
 
         iu = fixtoi32(u);
-        iu = iu & 0xff; /* keep only 8 bits */
+        iu = (iu & 0xff) >> bitc8; /* keep the top parambits[i] of 8 bits */
+
+        parm[f->byte] |= (unsigned char)(iu << f->shift);
+        if (f->spans)
+            parm[f->byte + 1] |= (unsigned char)(iu >> (8 - f->shift));
+    }
+    PROF_MARK(PROF_QUANT);
+}
+
+template <class cfg>
+static int encode_frames(const short *in, int frames, unsigned char *out, openlpc_encoder_state *st)
+{
+    int flen = cfg::framelen ? cfg::framelen : st->framelen;
+    int frame;
 
-        /* make room at the left of parm array shifting left */
-        for(j=sizeofparm-1; j >= 3; j--) {
-            parm[j] = (unsigned char)((parm[j] << bitamount) | (parm[j-1] >> bitc8));
+    for (frame = 0; frame < frames; frame++, in += flen, out += cfg::layout::size) {
+        prefilter<cfg>(in, flen, st->pos, st);
+        analyse<cfg>(out, st);
+    }
+    return frames * cfg::layout::size;
+}
+
+/* the first st->fill samples of the next frame have already replaced the
+   oldest ones in the ring */
+template <class cfg>
+static int encoder_push(const short *in, int n, unsigned char *out, int dtx, openlpc_encoder_state *st)
+{
+    int flen = cfg::framelen ? cfg::framelen : st->framelen;
+    int buflen = cfg::framelen ? cfg::framelen * 3 / 2 : st->buflen;
+    int m, start, bytes = 0;
+
+    while (n > 0) {
+        m = flen - st->fill;
+        if (m > n)
+            m = n;
+        start = st->pos + st->fill;
+        if (start >= buflen)
+            start -= buflen;
+        prefilter<cfg>(in, m, start, st);
+        in += m;
+        n -= m;
+
+        st->fill += m;
+        if (st->fill == flen) {
+            st->fill = 0;
+            analyse<cfg>(out + bytes, st);
+            if (!dtx || vad_send(out + bytes, st))
+                bytes += cfg::layout::size;
         }
-        parm[2] = (unsigned char)((parm[2] << bitamount) | (iu >> bitc8)); /* parm[2] */
     }
-    bcopy(st->s + st->framelen, st->s, (st->buflen - st->framelen)*sizeof(st->s[0]));
-    bcopy(st->y + st->framelen, st->y, (st->buflen - st->framelen)*sizeof(st->y[0]));
+    return bytes;
+}
+
+int openlpc_encode_frames(const short *in, int frames, unsigned char *out, openlpc_encoder_state *st)
+{
+    if (st->encode_frames == NULL)
+        return 0;
+    return st->encode_frames(in, frames, out, st);
+}
+
+int openlpc_encode(const short *buf, unsigned char *parm, openlpc_encoder_state *st)
+{
+    return openlpc_encode_frames(buf, 1, parm, st);
+}
+
+int openlpc_encoder_push(const short *in, int n, unsigned char *out, openlpc_encoder_state *st)
+{
+    if (st->push == NULL)
+        return 0;
+    return st->push(in, n, out, 0, st);
+}
+
+int openlpc_encoder_push_dtx(const short *in, int n, unsigned char *out, openlpc_encoder_state *st)
+{
+    if (st->push == NULL)
+        return 0;
+    return st->push(in, n, out, 1, st);
+}
+
+int openlpc_encode_dtx(const short *buf, unsigned char *parm, openlpc_encoder_state *st)
+{
+    int size = openlpc_encode_frames(buf, 1, parm, st);
 
-    return sizeofparm;
+    return size > 0 && vad_send(parm, st) ? size : 0;
 }
 
 openlpc_decoder_state *create_openlpc_decoder_state(void)
@@ -818,13 +1694,33 @@ openlpc_decoder_state *create_openlpc_decoder_state(void)
     openlpc_decoder_state *state;
 
     state = (openlpc_decoder_state *)malloc(sizeof(openlpc_decoder_state));
+    if(state != NULL)
+        state->decode_frames = NULL;
 
     return state;
 }
 
-void init_openlpc_decoder_state(openlpc_decoder_state *st, int framelen)
+static void init_random16(openlpc_random_t *rnd)
 {
-    int i, j;
+    rnd->y[0] = -21161;
+    rnd->y[1] = -8478;
+    rnd->y[2] = 30892;
+    rnd->y[3] = -10216;
+    rnd->y[4] = 16950;
+    rnd->j = MIDTAP;
+    rnd->k = MAXTAP;
+}
+
+/* On failure (frame too short, unknown lpcbits or synth) openlpc_decode()
+   produces nothing. */
+void init_openlpc_decoder_state_synth(openlpc_decoder_state *st, int framelen, int lpcbits, int synth)
+{
+    const lpc_variant *v = find_variant(framelen, lpcbits);
+    int i;
+
+    st->decode_frames = NULL;
+    if (framelen < 2 || v == NULL || (synth != OPENLPC_SYNTH_Q20 && synth != OPENLPC_SYNTH_Q15))
+        return;
 
     st->Oldper = 0;
     st->OldG = 0;
@@ -834,53 +1730,206 @@ void init_openlpc_decoder_state(openlpc_decoder_state *st, int framelen)
     }
     st->pitchctr = 0;
     st->exc = 0;
-    logmaxminper = fixlog32(fixdiv32(itofix32(MAXPER), itofix32(MINPER)));
+    memset(st->lastparm, 0, sizeof(st->lastparm));
+    st->noiseG = -1;        /* the first frame sets it */
+    st->lost = 0;
 
-    for(i=0, j=0; i<sizeof(parambits) / sizeof(parambits[0]); i++) {
-        j += parambits[i];
-    }
-    sizeofparm = (j + 7) / 8 + 2;
+    init_random16(&st->rnd);
 
-    /* test for a valid frame len? */
     st->framelen = framelen;
     st->buflen = framelen * 3 / 2;
     st->gainadj = fixsqrt32(itofix32(3) / st->buflen);
+    st->decode_frames = synth == OPENLPC_SYNTH_Q15 ? v->decode_frames_q15 : v->decode_frames;
 }
 
-#define MIDTAP 1
-#define MAXTAP 4
-static short y[MAXTAP+1]={-21161, -8478, 30892,-10216, 16950};
-static int j=MIDTAP, k=MAXTAP;
+void init_openlpc_decoder_state_bits(openlpc_decoder_state *st, int framelen, int lpcbits)
+{
+    init_openlpc_decoder_state_synth(st, framelen, lpcbits, OPENLPC_SYNTH_Q20);
+}
+
+void init_openlpc_decoder_state(openlpc_decoder_state *st, int framelen)
+{
+    init_openlpc_decoder_state_bits(st, framelen, OPENLPC_BITS_38);
+}
 
-__inline int random16 (void)
+static __inline int random16 (openlpc_random_t *rnd)
 {
     int the_random;
 
-    y[k] = (short)(y[k] + y[j]);
+    rnd->y[rnd->k] = (short)(rnd->y[rnd->k] + rnd->y[rnd->j]);
 
-    the_random = y[k];
-    k--;
-    if (k < 0) k = MAXTAP;
-    j--;
-    if (j < 0) j = MAXTAP;
+    the_random = rnd->y[rnd->k];
+    rnd->k--;
+    if (rnd->k < 0) rnd->k = MAXTAP;
+    rnd->j--;
+    if (rnd->j < 0) rnd->j = MAXTAP;
 
     return(the_random);
 }
 
-/* LPC Synthesis (decoding) */
+/* dequantizes one frame of parameters: the period of each half frame (0
+   if unvoiced), the gain and k[] */
+template <class cfg>
+static void dequantize(const unsigned char *parm,
+                       fixed32 hper[2], fixed32 *gain, fixed32 k[LPC_FILTORDER+1])
+{
+    int i;
+
+    hper[0] = hper[1] = (fixed32)pgm_read_dword(&dequant_per[parm[0]]);
+
+    if((parm[1] & 0x1) == 0) hper[0] = 0;
+    if((parm[1] & 0x2) == 0) hper[1] = 0;
+
+#ifdef LINEAR_G_Q
+    *gain = itofix32(parm[1]) / 128;
+#else
+    *gain = (fixed32)pgm_read_dword(&dequant_gain[parm[1]]);
+#endif
+
+    k[0] = 0;
+
+    for (i=0; i < LPC_FILTORDER; i++) {
+        const lpc_field *f = &cfg::layout::fields[i];
+        int v = parm[f->byte] >> f->shift;
+        signed char c;
+
+        if (f->spans)
+            v |= parm[f->byte + 1] << (8 - f->shift);
+        /* casting to char drops the bits above the field and sets the sign */
+        c = (signed char)(v << f->bitc8);
+
+        k[i+1] = itofix32(c) / 128;
+        if(cfg::arcsin_q && i<2) k[i+1] = (fixed32)pgm_read_dword(&dequant_arcsin[(unsigned char)c]);
+    }
+}
+
+/* made up parameters for a lost frame, from the last frame decoded */
+static void conceal(openlpc_decoder_state *st, fixed32 hper[2], fixed32 *gain, fixed32 k[LPC_FILTORDER+1])
+{
+    fixed32 noiseG = st->noiseG < 0 ? 0 : st->noiseG;
+    int i;
+
+    hper[0] = hper[1] = st->lost < PLC_VOICED ? st->Oldper : 0;
+    *gain = noiseG + fixmul32(st->OldG - noiseG, PLC_DECAY);
+    k[0] = 0;
+    for (i=1; i <= LPC_FILTORDER; i++)
+        k[i] = st->Oldk[i];
+    st->lost++;
+}
+
+#if SYNTH_MODE == SYNTH_FAST
+/* 1 / x in Q30 for x in Q20, 0 for 0 */
+static fixed32 fixrecip30(fixed32 x)
+{
+    if(x == 0)
+        return 0;
+    return (fixed32)(((fixed64)1 << (PRECISION + 30)) / x);
+}
+
+/* one Newton step r * (2 - x * r) towards 1 / x in Q30, from an r close to it */
+static __inline fixed32 fixrecip30_step(fixed32 x, fixed32 r)
+{
+    fixed64 e = ((fixed64)1 << 30) - (((fixed64)x * r) >> PRECISION);
+
+    return r + (fixed32)(((fixed64)r * e) >> 30);
+}
+
+#define per_recip(per)          fixrecip30(per)
+#define per_recip_step(per, r)  ((per) == 0 ? 0 : fixrecip30_step(per, r))
+#else
+#define per_recip(per)          0
+#define per_recip_step(per, r)  (r)
+#endif
+
+/* one sample of excitation: noise if unvoiced, else a triangular pulse
+   every Newper samples; rper is per_recip(Newper) */
+static __inline fixed32 excitation(fixed32 NewG, fixed32 Newper, fixed32 rper, fixed32 gainadj,
+                                   fixed32 *exc, int *pitchctr, openlpc_random_t *rnd)
+{
+    if (Newper == 0)
+        return fixmul32((random16(rnd) << (PRECISION - 15 - 1)), fixmul32(NewG, gainadj));
+
+    /* voiced: send a delta every per samples */
+    /* triangular excitation */
+    if (*pitchctr == 0) {
+        *exc = fixmul32(NewG, gainadj >> 2);
+        *pitchctr = fixtoi32(Newper);
+    } else {
+#if SYNTH_MODE == SYNTH_FAST
+        *exc -= fixmul32((fixed32)(((fixed64)NewG * rper) >> 30), gainadj >> 1);
+#else
+        *exc -= fixmul32(fixdiv32(NewG, Newper), gainadj >> 1);
+#endif
+        (*pitchctr)--;
+    }
+    return *exc;
+}
+
+/* Arithmetic of the synthesis lattice. synth_q20 is the 32 bit one, every
+   product a fixmul32(). synth_q15 keeps the signal in Q13 (two bits of
+   headroom over the output) and k[] in Q15, both saturated to 16 bits, so
+   every product is a 16x16 multiply, rounded; k[] is interpolated in Q30
+   and used through its top 16 bits. bp[] in the decoder state is in the
+   format of the path init picked. */
+struct synth_q20 {
+    typedef fixed32 coef;
+
+    static fixed32 kstate(fixed32 k)                { return k; }
+    static fixed32 kstep(fixed32 k, fixed32 oldk, int flen) { return (k - oldk) / flen; }
+    static coef    kcoef(fixed32 k)                 { return k; }
+    static fixed32 mul(coef k, fixed32 x)           { return fixmul32(k, x); }
+    static fixed32 sat(fixed32 x)                   { return x; }
+    static fixed32 in(fixed32 u)                    { return u; }
+    static short out(fixed32 u)
+    {
+        if (u  < ftofix32(-0.9999)) {
+            u = ftofix32(-0.9999);
+        } else if (u > ftofix32(0.9999)) {
+            u = ftofix32(0.9999);
+        }
+        return (short)(u >> (PRECISION - 15));
+    }
+};
+
+#define Q15_SIGNAL  13
+
+struct synth_q15 {
+    typedef int16_t coef;
+
+    static fixed32 kstate(fixed32 k)                { return k << (30 - PRECISION); }
+    static fixed32 kstep(fixed32 k, fixed32 oldk, int flen) { return ((k - oldk) << (30 - PRECISION)) / flen; }
+    static coef    kcoef(fixed32 k)                 { return (coef)sat(k >> 15); }
+    static fixed32 mul(coef k, fixed32 x)           { return ((int32_t)k * (int16_t)x + (1 << 14)) >> 15; }
+    static fixed32 sat(fixed32 x)                   { return x > 32767 ? 32767 : (x < -32768 ? -32768 : x); }
+    static fixed32 in(fixed32 u)
+    {
+        return sat((u + (1 << (PRECISION - Q15_SIGNAL - 1))) >> (PRECISION - Q15_SIGNAL));
+    }
+    static short out(fixed32 u)
+    {
+        return (short)sat(u << (15 - Q15_SIGNAL));
+    }
+};
+
+/* LPC Synthesis (decoding), of a lost frame if in is NULL */
 
-int openlpc_decode(unsigned char *parm, short *buf, openlpc_decoder_state *st)
+template <class cfg, class synth>
+static int decode_frames(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st)
 {
-    int i, j, flen=st->framelen;
+    int i, j, frame;
+    const int flen = cfg::framelen ? cfg::framelen : st->framelen;
+    const int buflen = cfg::framelen ? cfg::framelen * 3 / 2 : st->buflen;
     fixed32 per, gain, k[LPC_FILTORDER+1];
-    fixed32 u, NewG, Ginc, Newper, perinc;
+    fixed32 u, NewG, Ginc, Newper, perinc, rper;
     fixed32 Newk[LPC_FILTORDER+1], kinc[LPC_FILTORDER+1];
     fixed32 gainadj;
     int hframe;
     fixed32 hper[2];
     int ii;
     fixed32 bp0, bp1, bp2, bp3, bp4, bp5, bp6, bp7, bp8, bp9, bp10;
-    fixed32 stgain;
+    fixed32 stgain, exc;
+    int pitchctr;
+    openlpc_random_t rnd;
 
     bp0 = st->bp[0];
     bp1 = st->bp[1];
@@ -894,150 +1943,132 @@ int openlpc_decode(unsigned char *parm, short *buf, openlpc_decoder_state *st)
     bp9 = st->bp[9];
     bp10 = st->bp[10];
     stgain = st->gainadj;
+    exc = st->exc;
+    pitchctr = st->pitchctr;
+    rnd = st->rnd;
+
+    /* the lattice and excitation state stay in locals for the whole batch */
+    for (frame = 0; frame < frames; frame++, out += flen) {
+        short *buf = out;
+
+        PROF_BEGIN();
+
+        if (in != NULL) {
+            dequantize<cfg>(in, hper, &gain, k);
+            in += cfg::layout::size;
+
+            /* the quietest gain, creeping up by 1/128 per frame */
+            if (gain < st->noiseG || st->noiseG < 0)
+                st->noiseG = gain;
+            else
+                st->noiseG += (st->noiseG >> 7) + 1;
+            st->lost = 0;
+        } else {
+            conceal(st, hper, &gain, k);
+        }
+        PROF_MARK(PROF_UNPACK);
 
-    per = itofix32(parm[0]);
-
-    per = (fixed32)(per == 0? 0: REAL_MINPER * fixexp32(fixmul32(per/256, logmaxminper)));
-
-    hper[0] = hper[1] = per;
-
-    if((parm[1] & 0x1) == 0) hper[0] = 0;
-    if((parm[1] & 0x2) == 0) hper[1] = 0;
-
-#ifdef LINEAR_G_Q
-    gain = itofix32(parm[1]) / 128;
-#else
-    gain = itofix32(parm[1]) / 256;
-    gain = fixdiv32((fixexp32(gain) - itofix32(1)), ftofix32((2.718-1.f)/10));
-#endif
-
-    k[0] = 0;
+        /* k[] are the same in the two subframes */
+        for (i=1; i <= LPC_FILTORDER; i++) {
+            Newk[i] = synth::kstate(st->Oldk[i]);
+            kinc[i] = synth::kstep(k[i], st->Oldk[i], flen);
+        }
 
-    for (i=LPC_FILTORDER-1; i >= 0; i--) {
-        int bitamount = parambits[i];
-        int bitc8 = 8-bitamount;
-        /* casting to char should set the sign properly */
-        signed char c = (signed char)(parm[2] << bitc8);
+        /* Loop on two half frames */
 
-        for(j=2; j<sizeofparm; j++)
-            parm[j] = (unsigned char)((parm[j] >> bitamount) | (parm[j+1] << bitc8));
+        for(hframe=0, ii=0; hframe<2; hframe++) {
 
-        k[i+1] = itofix32(c) / 128;
-#ifdef ARCSIN_Q
-        if(i<2) k[i+1] = fixsin32(fixmul32(ftofix32(M_PI/2), k[i+1]));
-#endif
-    }
+            Newper = st->Oldper;
+            NewG = st->OldG;
 
-    /* k[] are the same in the two subframes */
-    for (i=1; i <= LPC_FILTORDER; i++) {
-        Newk[i] = st->Oldk[i];
-        kinc[i] = (k[i] - st->Oldk[i]) / flen;
-    }
+            Ginc = (gain - st->OldG) / (flen / 2);
+            per = hper[hframe];
 
-    /* Loop on two half frames */
+            if (per == 0) {          /* if unvoiced */
+                gainadj = stgain;
+            } else {
+                gainadj = fixsqrt32(per / buflen);
+            }
 
-    for(hframe=0, ii=0; hframe<2; hframe++) {
+            /* Interpolate period ONLY if both old and new subframes are voiced, gain and K always */
 
-        Newper = st->Oldper;
-        NewG = st->OldG;
+            if (st->Oldper != 0 && per != 0) {
+                perinc = (per - st->Oldper) / (flen / 2);
+            } else {
+                perinc = 0;
+                Newper = per;
+            }
 
-        Ginc = (gain - st->OldG) / (flen / 2);
-        per = hper[hframe];
+            if (Newper == 0) pitchctr = 0;
 
-        if (per == 0) {          /* if unvoiced */
-            gainadj = stgain;
-        } else {
-            gainadj = fixsqrt32(per / st->buflen);
-        }
+            rper = per_recip(Newper);
 
-        /* Interpolate period ONLY if both old and new subframes are voiced, gain and K always */
+            for (i=0; i < flen / 2; i++, ii++) {
+                typename synth::coef kj;
 
-        if (st->Oldper != 0 && per != 0) {
-            perinc = (per - st->Oldper) / (flen / 2);
-        } else {
-            perinc = 0;
-            Newper = per;
-        }
+                u = synth::in(excitation(NewG, Newper, rper, gainadj, &exc, &pitchctr, &rnd));
 
-        if (Newper == 0) st->pitchctr = 0;
+                kj = synth::kcoef(Newk[10]);
+                u = synth::sat(u - synth::mul(kj, bp9));
+                bp10 = synth::sat(bp9 + synth::mul(kj, u));
 
-        for (i=0; i < flen / 2; i++, ii++) {
-            fixed32 kj;
-
-            if (Newper == 0) {
-                u = fixmul32((random16() << (PRECISION - 15 - 1)), fixmul32(NewG, gainadj));
-            } else {            /* voiced: send a delta every per samples */
-                /* triangular excitation */
-                if (st->pitchctr == 0) {
-                    st->exc = fixmul32(NewG, gainadj >> 2);
-                    st->pitchctr = fixtoi32(Newper);
-                } else {
-                    st->exc -= fixmul32(fixdiv32(NewG, Newper), gainadj >> 1);
-                    st->pitchctr--;
-                }
-                u = st->exc;
-            }
+                kj = synth::kcoef(Newk[9]);
+                u = synth::sat(u - synth::mul(kj, bp8));
+                bp9 = synth::sat(bp8 + synth::mul(kj, u));
 
-            /* excitation */
-            kj = Newk[10];
-            u -= fixmul32(kj, bp9);
-            bp10 = bp9 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[8]);
+                u = synth::sat(u - synth::mul(kj, bp7));
+                bp8 = synth::sat(bp7 + synth::mul(kj, u));
 
-            kj = Newk[9];
-            u -= fixmul32(kj, bp8);
-            bp9 = bp8 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[7]);
+                u = synth::sat(u - synth::mul(kj, bp6));
+                bp7 = synth::sat(bp6 + synth::mul(kj, u));
 
-            kj = Newk[8];
-            u -= fixmul32(kj, bp7);
-            bp8 = bp7 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[6]);
+                u = synth::sat(u - synth::mul(kj, bp5));
+                bp6 = synth::sat(bp5 + synth::mul(kj, u));
 
-            kj = Newk[7];
-            u -= fixmul32(kj, bp6);
-            bp7 = bp6 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[5]);
+                u = synth::sat(u - synth::mul(kj, bp4));
+                bp5 = synth::sat(bp4 + synth::mul(kj, u));
 
-            kj = Newk[6];
-            u -= fixmul32(kj, bp5);
-            bp6 = bp5 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[4]);
+                u = synth::sat(u - synth::mul(kj, bp3));
+                bp4 = synth::sat(bp3 + synth::mul(kj, u));
 
-            kj = Newk[5];
-            u -= fixmul32(kj, bp4);
-            bp5 = bp4 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[3]);
+                u = synth::sat(u - synth::mul(kj, bp2));
+                bp3 = synth::sat(bp2 + synth::mul(kj, u));
 
-            kj = Newk[4];
-            u -= fixmul32(kj, bp3);
-            bp4 = bp3 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[2]);
+                u = synth::sat(u - synth::mul(kj, bp1));
+                bp2 = synth::sat(bp1 + synth::mul(kj, u));
 
-            kj = Newk[3];
-            u -= fixmul32(kj, bp2);
-            bp3 = bp2 + fixmul32(kj, u);
+                kj = synth::kcoef(Newk[1]);
+                u = synth::sat(u - synth::mul(kj, bp0));
+                bp1 = synth::sat(bp0 + synth::mul(kj, u));
 
-            kj = Newk[2];
-            u -= fixmul32(kj, bp1);
-            bp2 = bp1 + fixmul32(kj, u);
+                bp0 = u;
+                buf[ii] = synth::out(u);
 
-            kj = Newk[1];
-            u -= fixmul32(kj, bp0);
-            bp1 = bp0 + fixmul32(kj, u);
+                NewG += Ginc;
+                if (perinc != 0) {
+                    Newper += perinc;
+                    rper = per_recip_step(Newper, rper);
+                }
 
-            bp0 = u;
+                for (j=1; j <= LPC_FILTORDER; j++) Newk[j] += kinc[j];
 
-            if (u  < ftofix32(-0.9999)) {
-                u = ftofix32(-0.9999);
-            } else if (u > ftofix32(0.9999)) {
-                u = ftofix32(0.9999);
             }
-            buf[ii] = (short)(u >> (PRECISION - 15));
-
-            Newper += perinc;
-            NewG += Ginc;
-
-            for (j=1; j <= LPC_FILTORDER; j++) Newk[j] += kinc[j];
 
+            st->Oldper = per;
+            st->OldG = gain;
         }
 
-        st->Oldper = per;
-        st->OldG = gain;
+        for (j=1; j <= LPC_FILTORDER; j++) st->Oldk[j] = k[j];
+        PROF_MARK(PROF_SYNTH);
     }
+
     st->bp[0] = bp0;
     st->bp[1] = bp1;
     st->bp[2] = bp2;
@@ -1049,10 +2080,93 @@ int openlpc_decode(unsigned char *parm, short *buf, openlpc_decoder_state *st)
     st->bp[8] = bp8;
     st->bp[9] = bp9;
     st->bp[10] = bp10;
+    st->exc = exc;
+    st->pitchctr = pitchctr;
+    st->rnd = rnd;
+    if (frames > 0 && in != NULL)
+        memcpy(st->lastparm, in - cfg::layout::size, cfg::layout::size);
+
+    return frames * flen;
+}
+
+int openlpc_decode_frames(const unsigned char *in, int frames, short *out, openlpc_decoder_state *st)
+{
+    if (st->decode_frames == NULL)
+        return 0;
+    return st->decode_frames(in, frames, out, st);
+}
+
+/* the specialized variants first; opts are the OPENLPC_EXACT_FILTERS and
+   OPENLPC_LINEAR_Q bits of lpcbits */
+#define LPC_CONFIG(framelen, lpcbits, opts) \
+    lpc_config<framelen, lpcbits, !((opts) & OPENLPC_EXACT_FILTERS), !((opts) & OPENLPC_LINEAR_Q)>
+#define LPC_VARIANT_OPTS(framelen, lpcbits, opts) \
+    { framelen, (lpcbits) | (opts), lpc_layout<lpcbits>::size, \
+      encode_frames<LPC_CONFIG(framelen, lpcbits, opts) >, \
+      encoder_push<LPC_CONFIG(framelen, lpcbits, opts) >, \
+      decode_frames<LPC_CONFIG(framelen, lpcbits, opts), synth_q20>, \
+      decode_frames<LPC_CONFIG(framelen, lpcbits, opts), synth_q15>, \
+      dequantize<LPC_CONFIG(framelen, lpcbits, opts) > }
+#define LPC_VARIANT(framelen, lpcbits) LPC_VARIANT_OPTS(framelen, lpcbits, 0)
+
+static const lpc_variant variants[] = {
+#ifndef OPENLPC_GENERIC_ONLY
+    LPC_VARIANT(160, OPENLPC_BITS_38),
+    LPC_VARIANT(OPENLPC_FRAMESIZE_1_4, OPENLPC_BITS_32),
+#endif
+    LPC_VARIANT(0, OPENLPC_BITS_38),
+    LPC_VARIANT(0, OPENLPC_BITS_32),
+    LPC_VARIANT(0, OPENLPC_BITS_80),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_38, OPENLPC_EXACT_FILTERS),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_38, OPENLPC_LINEAR_Q),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_38, OPENLPC_EXACT_FILTERS | OPENLPC_LINEAR_Q),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_32, OPENLPC_EXACT_FILTERS),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_32, OPENLPC_LINEAR_Q),
+    LPC_VARIANT_OPTS(0, OPENLPC_BITS_32, OPENLPC_EXACT_FILTERS | OPENLPC_LINEAR_Q),
+};
+
+static const lpc_variant *find_variant(int framelen, int lpcbits)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        if (variants[i].lpcbits == lpcbits && (variants[i].framelen == framelen || variants[i].framelen == 0))
+            return &variants[i];
+    }
+    return NULL;
+}
 
-    for (j=1; j <= LPC_FILTORDER; j++) st->Oldk[j] = k[j];
+int openlpc_encoded_frame_size(int lpcbits)
+{
+    const lpc_variant *v = find_variant(0, lpcbits);
+
+    return v == NULL ? -1 : v->size;
+}
+
+int openlpc_decode(const unsigned char *parm, short *buf, openlpc_decoder_state *st)
+{
+    return openlpc_decode_frames(parm, 1, buf, st);
+}
+
+/* the last frame again, unvoiced: after a silence descriptor that is the
+   same noise, at the same level */
+int openlpc_decode_cng(short *buf, openlpc_decoder_state *st)
+{
+    unsigned char parm[OPENLPC_MAX_ENCODED_FRAME_SIZE];
 
-    return flen;
+    memcpy(parm, st->lastparm, sizeof(parm));
+    parm[1] &= 0xfc;
+    return openlpc_decode_frames(parm, 1, buf, st);
+}
+
+int openlpc_decode_lost(short *buf, openlpc_decoder_state *st)
+{
+    return openlpc_decode_frames(NULL, 1, buf, st);
+}
+
+int openlpc_decoder_state_size(const openlpc_decoder_state *st)
+{
+    return sizeof(*st);
 }
 
 void destroy_openlpc_decoder_state(openlpc_decoder_state *st)
@@ -1063,3 +2177,170 @@ void destroy_openlpc_decoder_state(openlpc_decoder_state *st)
         st = NULL;
     }
 }
+
+/* Multi-channel decoder */
+
+openlpc_multi_decoder_state *create_openlpc_multi_decoder_state(int channels)
+{
+    openlpc_multi_decoder_state *st;
+    int stride, lattice_size;
+
+    if (channels < 1)
+        return NULL;
+    st = (openlpc_multi_decoder_state *)malloc(sizeof(openlpc_multi_decoder_state));
+    if (st == NULL)
+        return NULL;
+
+    stride = (channels + 7) & ~7;
+    lattice_size = (LPC_FILTORDER + 1) * stride * sizeof(fixed32);
+    st->channels = channels;
+    st->stride = stride;
+    st->framelen = 0;
+    st->dequantize = NULL;
+    st->memsize = 4 * lattice_size + stride * sizeof(fixed32) + channels * sizeof(openlpc_md_channel_t);
+    st->mem = malloc(st->memsize);
+    if (st->mem == NULL) {
+        free(st);
+        return NULL;
+    }
+    st->bp = (fixed32 *)st->mem;
+    st->Oldk = st->bp + (LPC_FILTORDER + 1) * stride;
+    st->Newk = st->Oldk + (LPC_FILTORDER + 1) * stride;
+    st->kinc = st->Newk + (LPC_FILTORDER + 1) * stride;
+    st->u = st->kinc + (LPC_FILTORDER + 1) * stride;
+    st->ch = (openlpc_md_channel_t *)(st->u + stride);
+
+    return st;
+}
+
+/* On failure (frame too short, unknown lpcbits) openlpc_decode_multi()
+   produces nothing. */
+void init_openlpc_multi_decoder_state_bits(openlpc_multi_decoder_state *st, int framelen, int lpcbits)
+{
+    const lpc_variant *v = find_variant(framelen, lpcbits);
+    int i;
+
+    st->dequantize = NULL;
+    if (framelen < 2 || v == NULL)
+        return;
+
+    /* zeroes the lattice and the per channel state */
+    memset(st->mem, 0, st->memsize);
+    for (i = 0; i < st->channels; i++)
+        init_random16(&st->ch[i].rnd);
+
+    st->sizeofparm = v->size;
+    st->dequantize = v->dequantize;
+
+    st->framelen = framelen;
+    st->buflen = framelen * 3 / 2;
+    st->gainadj = fixsqrt32(itofix32(3) / st->buflen);
+}
+
+void init_openlpc_multi_decoder_state(openlpc_multi_decoder_state *st, int framelen)
+{
+    init_openlpc_multi_decoder_state_bits(st, framelen, OPENLPC_BITS_38);
+}
+
+/* decodes one frame of each channel: channel c is read from
+   in + c * openlpc_encoded_frame_size(lpcbits) and written to
+   out + c * framelen. Gives the same samples as a decoder per channel. */
+int openlpc_decode_multi(const unsigned char *in, short *out, openlpc_multi_decoder_state *st)
+{
+    int i, c, m, hframe, ii;
+    int flen = st->framelen, n = st->channels, stride = st->stride;
+    fixed32 k[LPC_FILTORDER+1];
+    openlpc_md_channel_t *ch;
+
+    if (st->dequantize == NULL)
+        return 0;
+
+    for (c=0, ch=st->ch; c < n; c++, ch++) {
+        st->dequantize(in + c * st->sizeofparm, ch->hper, &ch->gain, k);
+
+        /* k[] are the same in the two subframes */
+        for (m=1; m <= LPC_FILTORDER; m++) {
+            st->Newk[m * stride + c] = st->Oldk[m * stride + c];
+            st->kinc[m * stride + c] = (k[m] - st->Oldk[m * stride + c]) / flen;
+            st->Oldk[m * stride + c] = k[m];
+        }
+    }
+
+    /* Loop on two half frames */
+
+    for(hframe=0, ii=0; hframe<2; hframe++) {
+
+        for (c=0, ch=st->ch; c < n; c++, ch++) {
+            fixed32 per = ch->hper[hframe];
+
+            ch->Newper = ch->Oldper;
+            ch->NewG = ch->OldG;
+            ch->Ginc = (ch->gain - ch->OldG) / (flen / 2);
+
+            if (per == 0) {          /* if unvoiced */
+                ch->gainadj = st->gainadj;
+            } else {
+                ch->gainadj = fixsqrt32(per / st->buflen);
+            }
+
+            /* Interpolate period ONLY if both old and new subframes are voiced, gain and K always */
+
+            if (ch->Oldper != 0 && per != 0) {
+                ch->perinc = (per - ch->Oldper) / (flen / 2);
+            } else {
+                ch->perinc = 0;
+                ch->Newper = per;
+            }
+
+            if (ch->Newper == 0) ch->pitchctr = 0;
+
+            ch->rper = per_recip(ch->Newper);
+        }
+
+        for (i=0; i < flen / 2; i++, ii++) {
+            for (c=0, ch=st->ch; c < n; c++, ch++) {
+                st->u[c] = excitation(ch->NewG, ch->Newper, ch->rper, ch->gainadj,
+                                      &ch->exc, &ch->pitchctr, &ch->rnd);
+                ch->NewG += ch->Ginc;
+                if (ch->perinc != 0) {
+                    ch->Newper += ch->perinc;
+                    ch->rper = per_recip_step(ch->Newper, ch->rper);
+                }
+            }
+
+            lattice(st->u, st->bp, st->Newk, st->kinc, stride, n);
+
+            for (c=0; c < n; c++) {
+                fixed32 u = st->u[c];
+
+                if (u  < ftofix32(-0.9999)) {
+                    u = ftofix32(-0.9999);
+                } else if (u > ftofix32(0.9999)) {
+                    u = ftofix32(0.9999);
+                }
+                out[c * flen + ii] = (short)(u >> (PRECISION - 15));
+            }
+        }
+
+        for (c=0, ch=st->ch; c < n; c++, ch++) {
+            ch->Oldper = ch->hper[hframe];
+            ch->OldG = ch->gain;
+        }
+    }
+
+    return n * flen;
+}
+
+int openlpc_multi_decoder_state_size(const openlpc_multi_decoder_state *st)
+{
+    return sizeof(*st) + st->memsize;
+}
+
+void destroy_openlpc_multi_decoder_state(openlpc_multi_decoder_state *st)
+{
+    if(st != NULL)
+    {
+        free(st->mem);
+        free(st);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * Precomputed analysis windows for the fixed point OpenLPC encoder.
+ *
+ * WSCALE * (0.54 - 0.46 * cos(2 * PI * i / (buflen - 1))) in Q20, rounded
+ * like ftofix32(), for the frame lengths the firmware uses (buflen is
+ * framelen * 3 / 2). The window is symmetric, so only the first
+ * (buflen + 1) / 2 taps are stored. Included by openlpc_fixed.cpp only.
+ */
+
+#ifndef OPENLPC_WINDOW_H
+#define OPENLPC_WINDOW_H
+
+static const fixed32 hamming240[120] PROGMEM = {
+     133068,  133333,  134126,  135447,  137295,  139669,  142568,  145988,
+     149928,  154386,  159358,  164840,  170829,  177320,  184310,  191794,
+     199765,  208219,  217150,  226552,  236418,  246741,  257515,  268731,
+     280382,  292461,  304958,  317865,  331173,  344872,  358955,  373410,
+     388227,  403398,  418910,  434753,  450917,  467389,  484160,  501216,
+     518547,  536141,  553984,  572066,  590373,  608892,  627612,  646519,
+     665599,  684841,  704229,  723752,  743396,  763146,  782990,  802913,
+     822902,  842944,  863023,  883127,  903241,  923352,  943445,  963507,
+     983524, 1003482, 1023368, 1043166, 1062865, 1082450, 1101907, 1121224,
+    1140387, 1159382, 1178196, 1196818, 1215233, 1233428, 1251392, 1269113,
+    1286576, 1303772, 1320687, 1337310, 1353629, 1369634, 1385313, 1400656,
+    1415651, 1430288, 1444558, 1458450, 1471956, 1485064, 1497767, 1510056,
+    1521922, 1533356, 1544352, 1554902, 1564997, 1574632, 1583799, 1592492,
+    1600706, 1608434, 1615671, 1622413, 1628653, 1634390, 1639617, 1644332,
+    1648531, 1652212, 1655372, 1658008, 1660119, 1661704, 1662761, 1663290
+};
+
+static const fixed32 hamming375[188] PROGMEM = {
+     133068,  133176,  133500,  134040,  134795,  135766,  136952,  138353,
+     139969,  141798,  143841,  146097,  148565,  151244,  154135,  157235,
+     160544,  164062,  167787,  171718,  175854,  180194,  184737,  189481,
+     194425,  199568,  204907,  210443,  216173,  222095,  228208,  234510,
+     240999,  247674,  254532,  261572,  268792,  276190,  283763,  291509,
+     299427,  307513,  315767,  324184,  332764,  341504,  350400,  359451,
+     368654,  378007,  387506,  397150,  406935,  416858,  426918,  437110,
+     447433,  457883,  468457,  479152,  489966,  500895,  511936,  523086,
+     534342,  545700,  557158,  568713,  580360,  592097,  603921,  615827,
+     627813,  639876,  652011,  664216,  676487,  688821,  701213,  713662,
+     726162,  738711,  751305,  763940,  776613,  789321,  802059,  814825,
+     827614,  840423,  853248,  866086,  878933,  891785,  904639,  917492,
+     930339,  943177,  956002,  968811,  981600,  994365, 1007104, 1019811,
+    1032484, 1045120, 1057714, 1070263, 1082763, 1095211, 1107604, 1119937,
+    1132208, 1144413, 1156549, 1168611, 1180597, 1192504, 1204327, 1216065,
+    1227712, 1239266, 1250724, 1262083, 1273339, 1284489, 1295530, 1306459,
+    1317273, 1327968, 1338542, 1348992, 1359314, 1369507, 1379566, 1389490,
+    1399275, 1408918, 1418418, 1427770, 1436974, 1446025, 1454921, 1463660,
+    1472240, 1480658, 1488911, 1496998, 1504915, 1512662, 1520235, 1527632,
+    1534852, 1541892, 1548751, 1555426, 1561915, 1568217, 1574330, 1580252,
+    1585982, 1591517, 1596857, 1602000, 1606944, 1611688, 1616230, 1620570,
+    1624706, 1628637, 1632362, 1635880, 1639190, 1642290, 1645180, 1647860,
+    1650328, 1652584, 1654627, 1656456, 1658071, 1659472, 1660658, 1661629,
+    1662385, 1662924, 1663248, 1663356
+};
+
+static const fixed32 hamming480[240] PROGMEM = {
+     133068,  133134,  133332,  133661,  134121,  134714,  135437,  136292,
+     137278,  138394,  139642,  141020,  142528,  144166,  145934,  147832,
+     149858,  152014,  154297,  156709,  159248,  161915,  164708,  167627,
+     170673,  173843,  177138,  180557,  184099,  187764,  191552,  195461,
+     199491,  203641,  207911,  212300,  216806,  221430,  226170,  231026,
+     235997,  241082,  246279,  251589,  257010,  262542,  268183,  273932,
+     279788,  285751,  291820,  297993,  304269,  310647,  317126,  323706,
+     330384,  337160,  344032,  351000,  358062,  365217,  372463,  379800,
+     387226,  394741,  402341,  410027,  417798,  425650,  433584,  441598,
+     449691,  457861,  466106,  474426,  482819,  491283,  499817,  508420,
+     517090,  525825,  534625,  543487,  552410,  561393,  570433,  579530,
+     588682,  597887,  607144,  616451,  625806,  635208,  644656,  654147,
+     663680,  673253,  682865,  692514,  702199,  711917,  721668,  731448,
+     741258,  751094,  760956,  770841,  780748,  790676,  800622,  810585,
+     820562,  830554,  840556,  850569,  860590,  870618,  880650,  890685,
+     900721,  910758,  920791,  930821,  940846,  950863,  960871,  970868,
+     980853,  990823, 1000778, 1010715, 1020632, 1030529, 1040403, 1050252,
+    1060075, 1069870, 1079636, 1089371, 1099072, 1108739, 1118370, 1127963,
+    1137517, 1147029, 1156498, 1165923, 1175302, 1184633, 1193915, 1203146,
+    1212325, 1221450, 1230519, 1239530, 1248484, 1257376, 1266207, 1274975,
+    1283678, 1292314, 1300883, 1309383, 1317811, 1326168, 1334451, 1342658,
+    1350790, 1358843, 1366817, 1374711, 1382523, 1390251, 1397894, 1405452,
+    1412922, 1420304, 1427596, 1434797, 1441905, 1448920, 1455841, 1462665,
+    1469392, 1476021, 1482551, 1488979, 1495307, 1501531, 1507652, 1513668,
+    1519578, 1525381, 1531076, 1536662, 1542139, 1547504, 1552758, 1557900,
+    1562927, 1567841, 1572639, 1577321, 1581886, 1586334, 1590663, 1594873,
+    1598964, 1602933, 1606782, 1610508, 1614112, 1617593, 1620950, 1624183,
+    1627290, 1630273, 1633129, 1635859, 1638462, 1640937, 1643285, 1645505,
+    1647596, 1649558, 1651391, 1653094, 1654667, 1656110, 1657423, 1658605,
+    1659656, 1660577, 1661366, 1662024, 1662550, 1662945, 1663208, 1663340
+};
+
+#endif /* OPENLPC_WINDOW_H */